@@ -1,114 +1,150 @@
 #pragma once
 #include <vector>
 #include <limits>
-#include <memory>
 #include <unordered_map>
 #include <cassert>
+#include <cstdint>
+#include <algorithm>
 
 /**
- * @brief A very simple segment tree for RMQ from TAs
+ * @brief A skyline contour stored as a singly linked list of segments
+ *
+ * Each segment covers [x, next->x) at height y, and the last segment extends
+ * to infinity. The B*-tree places every node at the start of an existing
+ * segment, so the cost of a pack depends on the number of nodes instead of the
+ * total width. The segment pool is kept between calls to avoid reallocation.
+ *
+ * Every modification is recorded in an undo log, so the contour can be rolled
+ * back to any checkpoint taken earlier in the same pack.
  */
 template <typename T>
-class SegmentTree
+class Contour
 {
-    struct Node
+    struct Segment
     {
-        T data, tag;
-        bool hasTag;
-
-        Node() : data(0), tag(0), hasTag(false) {}
+        T x, y;
+        int next;
     };
 
-    size_t n;
-    std::vector<Node> seg;
+    std::vector<Segment> segs;
+    std::vector<std::pair<int, Segment>> log;
 
-    T getVal(size_t id) const
+    void modify(int s)
     {
-        return (seg[id].hasTag) ? seg[id].tag : seg[id].data;
+        log.emplace_back(s, segs[s]);
     }
 
-    void pull(size_t id)
+public:
+    struct Checkpoint
     {
-        seg[id].data = std::max(getVal(id * 2), getVal(id * 2 + 1));
-    }
+        size_t logSize, segSize;
+    };
 
-    void push(size_t id)
+    /**
+     * @brief Reset the contour to a single segment at height 0, return its index
+     */
+    int init()
     {
-        if (seg[id].hasTag)
-        {
-            seg[id].data = getVal(id);
-            seg[id].hasTag = false;
-            seg[id * 2].tag = seg[id].tag;
-            seg[id * 2].hasTag = true;
-            seg[id * 2 + 1].tag = seg[id].tag;
-            seg[id * 2 + 1].hasTag = true;
-        }
+        segs.clear();
+        log.clear();
+        segs.push_back({0, 0, -1});
+        return 0;
     }
 
-    T query(size_t ql, size_t qr, size_t l, size_t r, size_t id = 1)
+    /**
+     * @brief Reserve the buffers for a pack of numNodes blocks
+     *
+     * Each placed block adds at most one segment and two log entries, and a
+     * rollback only truncates them, so the buffers never grow afterwards.
+     */
+    void reserve(size_t numNodes)
     {
-        if (ql > r || qr < l)
-            return std::numeric_limits<T>::min();
-        if (ql <= l && qr >= r)
-            return getVal(id);
-
-        push(id);
-        int mid = (l + r) / 2;
-        return std::max(query(ql, qr, l, mid, id * 2), query(ql, qr, mid + 1, r, id * 2 + 1));
+        segs.reserve(numNodes + 1);
+        log.reserve(2 * numNodes);
     }
 
-    void update(T val, size_t ql, size_t qr, size_t l, size_t r, size_t id = 1)
-    {
-        if (ql > r || qr < l)
-            return;
-        if (ql <= l && qr >= r)
-        {
-            seg[id].tag = val;
-            seg[id].hasTag = true;
-            return;
-        }
-
-        push(id);
-        size_t mid = (l + r) / 2;
-        update(val, ql, qr, l, mid, id * 2);
-        update(val, ql, qr, mid + 1, r, id * 2 + 1);
-        pull(id);
-    }
-
-public:
-    SegmentTree() : n(0) {}
-
-    void init(size_t n_)
+    Checkpoint checkpoint() const
     {
-        n = n_;
-        seg.assign(n_ * 4, {});
+        return {log.size(), segs.size()};
     }
 
-    T query(size_t ql, size_t qr)
+    /**
+     * @brief Undo every modification made after the checkpoint
+     */
+    void rollback(const Checkpoint &cp)
     {
-        return query(ql, qr, 0ULL, n - 1);
+        while (log.size() > cp.logSize)
+        {
+            segs[log.back().first] = log.back().second;
+            log.pop_back();
+        }
+        segs.resize(cp.segSize);
     }
 
-    void update(size_t ql, size_t qr, T val)
+    /**
+     * @brief Place a block at the start of segment s, return the segment starting at the right edge of the block
+     */
+    int place(int s, T width, T height, T &y)
     {
-        update(val, ql, qr, 0ULL, n - 1);
+        y = segs[s].y;
+        if (width <= 0)
+            return s;
+
+        T endX = segs[s].x + width;
+        int last = s;
+        int cur = segs[s].next;
+        while (cur != -1 && segs[cur].x < endX)
+        {
+            y = std::max(y, segs[cur].y);
+            last = cur;
+            cur = segs[cur].next;
+        }
+        if (cur == -1 || segs[cur].x > endX)
+        {
+            if (last != s)
+            {
+                modify(last);
+                segs[last].x = endX;
+                cur = last;
+            }
+            else
+            {
+                segs.push_back({endX, segs[s].y, cur});
+                cur = segs.size() - 1;
+            }
+        }
+        modify(s);
+        segs[s].next = cur;
+        segs[s].y = y + height;
+        return cur;
     }
 };
 
 /**
- * @brief The node structure of the B*-tree
+ * @brief The index of a missing node
+ */
+constexpr std::int32_t nullNode = -1;
+
+/**
+ * @brief The node structure of the B*-tree, linked by indices into a NodeArena
  */
 template <typename T>
 struct Node
 {
-    using ptr = std::unique_ptr<Node>;
-
     T x, y;
     T width, height;
-    Node *parent, *lchild, *rchild;
+    std::int32_t parent, lchild, rchild;
     int blockId;
 
-    Node() : x(0), y(0), width(0), height(0), parent(nullptr), lchild(nullptr), rchild(nullptr) {}
+    // Bookkeeping of the last pack, used by the incremental re-pack
+    size_t preorderIdx;
+    int seg, endSeg;
+
+    // Positions in the leaf and open slot sets of the tree, -1 if absent
+    std::int32_t leafPos, slotPos;
+
+    Node() : x(0), y(0), width(0), height(0), parent(nullNode), lchild(nullNode), rchild(nullNode), blockId(-1),
+             preorderIdx(std::numeric_limits<size_t>::max()), seg(-1), endSeg(-1), leafPos(-1), slotPos(-1) {}
 
     void setPosition(T x_, T y_)
     {
@@ -123,68 +159,214 @@ struct Node
     }
 };
 
+/**
+ * @brief Contiguous storage of nodes addressed by 32-bit indices
+ *
+ * Nodes hold no pointers, so copying the arena clones every tree stored in it
+ * and the nodes are freed together with the arena.
+ */
+template <typename T>
+class NodeArena
+{
+    std::vector<Node<T>> nodes;
+
+public:
+    std::int32_t create()
+    {
+        nodes.emplace_back();
+        return nodes.size() - 1;
+    }
+
+    Node<T> &operator[](std::int32_t i)
+    {
+        return nodes[i];
+    }
+
+    const Node<T> &operator[](std::int32_t i) const
+    {
+        return nodes[i];
+    }
+
+    size_t size() const
+    {
+        return nodes.size();
+    }
+};
+
 /**
  * @brief A B*-tree to calculate the coordinates of nodes and the area of placement
+ *
+ * The tree only stores the index of its root, the nodes live in a NodeArena
+ * which is passed to every call. Several trees may share one arena.
+ *
+ * The nodes are packed in preorder and a checkpoint of the contour is kept
+ * before each of them. Callers report modified nodes with touch() or
+ * setShape(), and the next setPosition() only re-packs the suffix of the
+ * preorder starting at the earliest touched node. The prefix is unaffected
+ * because its nodes and the pending right children of their ancestors are
+ * unchanged.
+ *
+ * The tree can also keep the set of its leaves and the set of its nodes with a
+ * free child slot, so a random leaf or insertion point is picked in O(1).
+ * Callers report nodes whose children changed with updateSlots().
+ *
+ * A mirrored tree places lchild above and rchild to the right of its parent
+ * instead, see setMirrored().
  */
 template <typename T>
 class BStarTree
 {
-    std::unordered_map<Node<T> *, int64_t> toInorderIdx;
-    SegmentTree<T> contourH;
+    struct Checkpoint
+    {
+        typename Contour<T>::Checkpoint contour;
+        T width, height;
+    };
+
+    std::unordered_map<std::int32_t, int64_t> toInorderIdx;
+    Contour<T> contourH;
 
-    Node<T> *buildTree(Node<T> *parent, const std::vector<Node<T> *> &preorder, const std::vector<Node<T> *> &inorder, size_t &i, int64_t l, int64_t r)
+    std::vector<std::int32_t> preorder;
+    std::vector<Checkpoint> checkpoints;
+    std::int32_t packedRoot;
+    size_t dirty;
+    T width, height;
+
+    std::vector<std::int32_t> leaves;
+    std::vector<std::int32_t> openSlots;
+    size_t capacity;
+    bool mirrored;
+
+    /**
+     * @brief Insert or erase a node in an indexed set, the position is stored in the node
+     */
+    static void setMember(NodeArena<T> &arena, std::vector<std::int32_t> &set, std::int32_t Node<T>::*pos, std::int32_t node, bool member)
+    {
+        std::int32_t &idx = arena[node].*pos;
+        if (member && idx == -1)
+        {
+            idx = set.size();
+            set.push_back(node);
+        }
+        else if (!member && idx != -1)
+        {
+            std::int32_t last = set.back();
+            set[idx] = last;
+            arena[last].*pos = idx;
+            set.pop_back();
+            idx = -1;
+        }
+    }
+
+    std::int32_t buildTree(NodeArena<T> &arena, std::int32_t parent, const std::vector<std::int32_t> &preorder, const std::vector<std::int32_t> &inorder, size_t &i, int64_t l, int64_t r)
     {
         if (l > r || i >= preorder.size())
-            return nullptr;
+            return nullNode;
 
-        Node<T> *node = preorder[i++];
+        std::int32_t node = preorder[i++];
         assert(toInorderIdx.count(node) > 0 && "Node not found in inorder map.");
         int64_t idx = toInorderIdx[node];
-        node->parent = parent;
-        node->lchild = buildTree(node, preorder, inorder, i, l, idx - 1);
-        node->rchild = buildTree(node, preorder, inorder, i, idx + 1, r);
+        arena[node].parent = parent;
+        arena[node].lchild = buildTree(arena, node, preorder, inorder, i, l, idx - 1);
+        arena[node].rchild = buildTree(arena, node, preorder, inorder, i, idx + 1, r);
         return node;
     }
 
-    T getTotalWidth(Node<T> *node) const
+    /**
+     * @brief The child placed to the right of the node, i.e. lchild unless the tree is mirrored
+     */
+    std::int32_t rightOf(const Node<T> &n) const
     {
-        if (!node)
-            return 0;
+        return mirrored ? n.rchild : n.lchild;
+    }
 
-        return node->width + getTotalWidth(node->lchild) + getTotalWidth(node->rchild);
+    /**
+     * @brief The child placed above the node, i.e. rchild unless the tree is mirrored
+     */
+    std::int32_t aboveOf(const Node<T> &n) const
+    {
+        return mirrored ? n.lchild : n.rchild;
     }
 
-    void setPosition(Node<T> *node, T startX)
+    std::int32_t nextPreorder(const NodeArena<T> &arena, std::int32_t node) const
     {
-        if (!node)
-            return;
+        if (rightOf(arena[node]) != nullNode)
+            return rightOf(arena[node]);
+        if (aboveOf(arena[node]) != nullNode)
+            return aboveOf(arena[node]);
 
-        T endX = startX + node->width;
-        T y = contourH.query(startX, endX - 1);
-        contourH.update(startX, endX - 1, y + node->height);
-        node->setPosition(startX, y);
-        setPosition(node->lchild, endX);
-        setPosition(node->rchild, startX);
+        while (node != root)
+        {
+            std::int32_t parent = arena[node].parent;
+            if (rightOf(arena[parent]) == node && aboveOf(arena[parent]) != nullNode)
+                return aboveOf(arena[parent]);
+            node = parent;
+        }
+        return nullNode;
     }
 
-    std::pair<T, T> getWidthHeight(Node<T> *node) const
+public:
+    std::int32_t root;
+
+    /**
+     * @brief The packing state kept between calls
+     */
+    struct State
     {
-        if (!node)
-            return {0, 0};
+        Contour<T> contour;
+        std::vector<std::int32_t> preorder;
+        std::vector<Checkpoint> checkpoints;
+        std::int32_t packedRoot{nullNode};
+        size_t dirty{0};
+        T width{0}, height{0};
+        std::vector<std::int32_t> leaves;
+        std::vector<std::int32_t> openSlots;
+        bool mirrored{false};
+
+        void reserve(size_t numNodes)
+        {
+            contour.reserve(numNodes);
+            preorder.reserve(numNodes);
+            checkpoints.reserve(numNodes);
+            leaves.reserve(numNodes);
+            openSlots.reserve(numNodes);
+        }
+    };
+
+    BStarTree() : packedRoot(nullNode), dirty(0), width(0), height(0), capacity(0), mirrored(false), root(nullNode) {}
 
-        auto [lMaxWidth, lMaxHeight] = getWidthHeight(node->lchild);
-        auto [rMaxWidth, rMaxHeight] = getWidthHeight(node->rchild);
-        T maxWidth = std::max(std::max(lMaxWidth, rMaxWidth), node->x + node->width);
-        T maxHeight = std::max(std::max(lMaxHeight, rMaxHeight), node->y + node->height);
-        return {maxWidth, maxHeight};
+    /**
+     * @brief Copies keep the capacity reserved by reserve(), a plain vector copy would shrink it to the size
+     */
+    BStarTree(const BStarTree &other) : BStarTree()
+    {
+        *this = other;
     }
 
-public:
-    Node<T> *root;
+    BStarTree &operator=(const BStarTree &other)
+    {
+        if (this == &other)
+            return *this;
+
+        toInorderIdx = other.toInorderIdx;
+        contourH = other.contourH;
+        preorder = other.preorder;
+        checkpoints = other.checkpoints;
+        packedRoot = other.packedRoot;
+        dirty = other.dirty;
+        width = other.width;
+        height = other.height;
+        leaves = other.leaves;
+        openSlots = other.openSlots;
+        mirrored = other.mirrored;
+        root = other.root;
+        reserve(other.capacity);
+        return *this;
+    }
 
-    BStarTree() : root(nullptr) {}
+    BStarTree(BStarTree &&) = default;
+    BStarTree &operator=(BStarTree &&) = default;
 
-    void buildTree(const std::vector<Node<T> *> &preorder, const std::vector<Node<T> *> &inorder)
+    void buildTree(NodeArena<T> &arena, const std::vector<std::int32_t> &preorder, const std::vector<std::int32_t> &inorder)
     {
         assert(preorder.size() == inorder.size() && "The size of preorder and inorder must be the same.");
         int64_t n = inorder.size();
@@ -194,19 +376,219 @@ public:
             toInorderIdx[inorder[i]] = i;
 
         size_t i = 0;
-        root = buildTree(nullptr, preorder, inorder, i, 0LL, n - 1);
+        root = buildTree(arena, nullNode, preorder, inorder, i, 0LL, n - 1);
         toInorderIdx.clear();
+        invalidate();
+    }
+
+    /**
+     * @brief Mark a node whose links or shape changed since the last pack
+     */
+    void touch(const NodeArena<T> &arena, std::int32_t node)
+    {
+        if (node == nullNode)
+            return;
+
+        size_t idx = arena[node].preorderIdx;
+        if (idx < preorder.size() && preorder[idx] == node)
+            dirty = std::min(dirty, idx);
+        else
+            dirty = 0;
+    }
+
+    /**
+     * @brief Force the next pack to start from the root
+     */
+    void invalidate()
+    {
+        dirty = 0;
     }
 
-    void setPosition()
+    /**
+     * @brief Reserve every buffer for a tree of numNodes nodes
+     *
+     * Packing, the slot sets and save()/restore() then run without allocation,
+     * since copying into a vector with enough capacity reuses its storage.
+     */
+    void reserve(size_t numNodes)
     {
-        contourH.init(getTotalWidth(root));
-        setPosition(root, 0);
+        capacity = numNodes;
+        contourH.reserve(numNodes);
+        preorder.reserve(numNodes);
+        checkpoints.reserve(numNodes);
+        leaves.reserve(numNodes);
+        openSlots.reserve(numNodes);
+    }
+
+    void save(State &state) const
+    {
+        state.reserve(capacity);
+        state.contour = contourH;
+        state.preorder = preorder;
+        state.checkpoints = checkpoints;
+        state.packedRoot = packedRoot;
+        state.dirty = dirty;
+        state.width = width;
+        state.height = height;
+        state.leaves = leaves;
+        state.openSlots = openSlots;
+        state.mirrored = mirrored;
+    }
+
+    void restore(const State &state)
+    {
+        contourH = state.contour;
+        preorder = state.preorder;
+        checkpoints = state.checkpoints;
+        packedRoot = state.packedRoot;
+        dirty = state.dirty;
+        width = state.width;
+        height = state.height;
+        leaves = state.leaves;
+        openSlots = state.openSlots;
+        mirrored = state.mirrored;
+    }
+
+    /**
+     * @brief Rebuild the leaf and open slot sets from the given nodes of the tree
+     */
+    void trackSlots(NodeArena<T> &arena, const std::vector<std::int32_t> &nodes)
+    {
+        leaves.clear();
+        openSlots.clear();
+        for (std::int32_t node : nodes)
+        {
+            arena[node].leafPos = -1;
+            arena[node].slotPos = -1;
+            updateSlots(arena, node);
+        }
+    }
+
+    /**
+     * @brief Update the sets after the children of a tracked node changed
+     */
+    void updateSlots(NodeArena<T> &arena, std::int32_t node)
+    {
+        if (node == nullNode)
+            return;
+
+        const Node<T> &n = arena[node];
+        bool isLeaf = n.lchild == nullNode && n.rchild == nullNode;
+        bool isOpen = n.lchild == nullNode || n.rchild == nullNode;
+        setMember(arena, leaves, &Node<T>::leafPos, node, isLeaf);
+        setMember(arena, openSlots, &Node<T>::slotPos, node, isOpen);
+    }
+
+    /**
+     * @brief Remove a node detached from the tree from both sets
+     */
+    void eraseSlots(NodeArena<T> &arena, std::int32_t node)
+    {
+        setMember(arena, leaves, &Node<T>::leafPos, node, false);
+        setMember(arena, openSlots, &Node<T>::slotPos, node, false);
+    }
+
+    /**
+     * @brief Exchange the roles of lchild and rchild for every node in O(1)
+     *
+     * The links are kept as they are and only packing reads them the other way
+     * round, which gives the same placement as swapping the children of every
+     * node. Both slot sets are symmetric in the two children, so they stay valid.
+     */
+    void setMirrored(bool mirrored_)
+    {
+        if (mirrored != mirrored_)
+        {
+            mirrored = mirrored_;
+            invalidate();
+        }
+    }
+
+    bool isMirrored() const
+    {
+        return mirrored;
+    }
+
+    const std::vector<std::int32_t> &getLeaves() const
+    {
+        return leaves;
+    }
+
+    const std::vector<std::int32_t> &getOpenSlots() const
+    {
+        return openSlots;
+    }
+
+    void setShape(NodeArena<T> &arena, std::int32_t node, T width_, T height_)
+    {
+        if (arena[node].width != width_ || arena[node].height != height_)
+        {
+            arena[node].setShape(width_, height_);
+            touch(arena, node);
+        }
+    }
+
+    void setPosition(NodeArena<T> &arena)
+    {
+        if (root != packedRoot)
+            dirty = 0;
+        if (dirty == std::numeric_limits<size_t>::max())
+            return;
+
+        std::int32_t node;
+        if (dirty == 0)
+        {
+            node = root;
+            contourH.init();
+            width = height = 0;
+        }
+        else
+        {
+            node = preorder[dirty];
+            contourH.rollback(checkpoints[dirty].contour);
+            width = checkpoints[dirty].width;
+            height = checkpoints[dirty].height;
+        }
+        preorder.resize(dirty);
+        checkpoints.resize(dirty);
+
+        for (; node != nullNode; node = nextPreorder(arena, node))
+        {
+            checkpoints.push_back({contourH.checkpoint(), width, height});
+            Node<T> &n = arena[node];
+            n.preorderIdx = preorder.size();
+            preorder.push_back(node);
+
+            T startX = 0;
+            int seg = 0;
+            if (node != root)
+            {
+                const Node<T> &parent = arena[n.parent];
+                if (rightOf(parent) == node)
+                {
+                    startX = parent.x + parent.width;
+                    seg = parent.endSeg;
+                }
+                else
+                {
+                    startX = parent.x;
+                    seg = parent.seg;
+                }
+            }
+
+            T y;
+            n.seg = seg;
+            n.endSeg = contourH.place(seg, n.width, n.height, y);
+            n.setPosition(startX, y);
+            width = std::max(width, startX + n.width);
+            height = std::max(height, y + n.height);
+        }
+        packedRoot = root;
+        dirty = std::numeric_limits<size_t>::max();
     }
 
     T getArea() const
     {
-        auto [width, height] = getWidthHeight(root);
         return width * height;
     }
 };
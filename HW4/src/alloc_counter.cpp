@@ -0,0 +1,46 @@
+#include "alloc_counter.hpp"
+
+#ifdef PLACER_COUNT_ALLOCS
+#include <cstdlib>
+#include <new>
+
+static thread_local std::int64_t alloc_count = 0;
+
+std::int64_t GetAllocCount() {
+    return alloc_count;
+}
+
+// 其他版本的 operator new (array、nothrow) 預設都會轉呼叫這兩個
+void *operator new(std::size_t size) {
+    alloc_count += 1;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    alloc_count += 1;
+    const std::size_t a = static_cast<std::size_t>(align);
+    if (void *p = std::aligned_alloc(a, (size + a - 1) / a * a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+/*
+ * 除錯用的記憶體配置計數。以 -DPLACER_COUNT_ALLOCS 編譯 (make alloccheck) 時，
+ * alloc_counter.cpp 會取代全域的 operator new，記錄每個 thread 呼叫了幾次，
+ * SA 用它檢查擾動、pack 與還原的過程沒有配置記憶體。一般編譯時什麼都不做。
+ */
+#ifdef PLACER_COUNT_ALLOCS
+std::int64_t GetAllocCount();
+#else
+inline std::int64_t GetAllocCount() { return 0; }
+#endif
@@ -1,46 +1,47 @@
 #include <algorithm>
-#include <cassert>
-#include <climits>
 #include <cstdint>
-#include <stack>
 #include <limits>
 
 #include "asf_island.hpp"
+#include "geometry.hpp"
 #include "utils.hpp"
 
 /// BuildInitialSolution 把  pair_represent_nodes 构成一棵平衡树，
 /// 再把 self_represent_nodes 串到最 “极端” 的那条分支上
-void AsfIsland::BuildInitialSolution() {
+void AsfIsland::BuildInitialSolution(NodeArenaType &arena) {
+    auto LargerArea = [&](NodeIndex a, NodeIndex b) {
+        return arena[a].width * arena[a].height > arena[b].width * arena[b].height;
+    };
+
     // 1. 只用 pair_represent_nodes 先做平衡树
     auto sorted = pair_represent_nodes_;
-    std::sort(sorted.begin(), sorted.end(),
-              [](auto a, auto b){
-                  return a->width * a->height > b->width * b->height;
-              });
+    std::sort(sorted.begin(), sorted.end(), LargerArea);
     if (sorted.empty()) {
-        pair_root_ = nullptr;
+        pair_root_ = nullNode;
     } else {
-        pair_root_ = BuildBalancedTree(sorted);
+        pair_root_ = BuildBalancedTree(arena, sorted);
     }
-    // 2. 把所有 self_represent_nodes 串成一条链
+    // 2. 把所有 self_represent_nodes 串成一条链，初始解沒有鏡射，方向只由對稱軸決定
+    bs_tree_.setMirrored(false);
     sorted = self_represent_nodes_;
 
     if (sorted.empty()) {
-        self_root_ = nullptr;
+        self_root_ = nullNode;
     } else {
-        std::sort(sorted.begin(), sorted.end(),
-                  [](auto a, auto b){
-                      return a->width * a->height > b->width * b->height;
-                  });
-        if (group_->axis == Axis::kVertical) {
-            self_root_ = BuildRightSkewedTree(sorted);
+        std::sort(sorted.begin(), sorted.end(), LargerArea);
+        if (group_.axis == Axis::kVertical) {
+            self_root_ = BuildRightSkewedTree(arena, sorted);
         } else {
-            self_root_ = BuildLeftSkewedTree(sorted);
+            self_root_ = BuildLeftSkewedTree(arena, sorted);
         }
     }
+    // 擾動只會作用在 pair tree 上，self tree 只在 pack 時暫時接上
+    bs_tree_.reserve(all_represent_nodes_.size());
+    bs_tree_.trackSlots(arena, pair_represent_nodes_);
+    bs_tree_.invalidate();
 }
 
-void AsfIsland::Initialize(std::vector<Block> &blocks) {
+void AsfIsland::Initialize(NodeArenaType &arena, Placement &placement) {
     if (!pair_represent_nodes_.empty() ||
             !self_represent_nodes_.empty()) {
         // 已經初始化過了
@@ -48,16 +49,16 @@ void AsfIsland::Initialize(std::vector<Block> &blocks) {
     }
 
     // (a) symmetry‑pair：固定使用右側模組 b' 當代表
-    for (const auto& symm_pair: group_->pairs) {
-        pair_represent_nodes_.emplace_back(new NodeType());
-        pair_represent_nodes_.back()->blockId = symm_pair.bid;
+    for (const auto& symm_pair: group_.pairs) {
+        pair_represent_nodes_.emplace_back(arena.create());
+        arena[pair_represent_nodes_.back()].blockId = symm_pair.bid;
         block_ids_.emplace_back(symm_pair.aid);
         block_ids_.emplace_back(symm_pair.bid);
     }
     // (b) self‑symmetric：取右(上)半；width/height 擇一對半
-    for (const auto& symm_self: group_->selfs) {
-        self_represent_nodes_.emplace_back(new NodeType());
-        self_represent_nodes_.back()->blockId = symm_self.id;
+    for (const auto& symm_self: group_.selfs) {
+        self_represent_nodes_.emplace_back(arena.create());
+        arena[self_represent_nodes_.back()].blockId = symm_self.id;
         block_ids_.emplace_back(symm_self.id);
     }
 
@@ -67,51 +68,82 @@ void AsfIsland::Initialize(std::vector<Block> &blocks) {
     all_represent_nodes_.insert(std::end(all_represent_nodes_),
         std::begin(self_represent_nodes_), std::end(self_represent_nodes_));
 
-    UpdateNodes(blocks);
-    BuildInitialSolution();
+    local_x_.assign(block_ids_.size(), 0);
+    local_y_.assign(block_ids_.size(), 0);
+    local_w_.assign(block_ids_.size(), 0);
+    local_h_.assign(block_ids_.size(), 0);
+
+    // 建立代表節點 -> mate 的查表，pack 時不必再搜尋 group_
+    mate_ids_.assign(all_represent_nodes_.size(), -1);
+    for (size_t i = 0; i < group_.pairs.size(); ++i) {
+        mate_ids_[i] = group_.pairs[i].aid;
+    }
+
+    UpdateNodes(arena, placement);
+    BuildInitialSolution(arena);
 }
 
-void AsfIsland::UpdateNodes(const std::vector<Block>& blocks) {
-    for (NodePointer n: pair_represent_nodes_) {
-        n->setShape(
-            blocks[n->blockId].GetRotatedWidth(),
-            blocks[n->blockId].GetRotatedHeight()
+void AsfIsland::UpdateNodes(NodeArenaType &arena, const Placement& placement) {
+    for (NodeIndex n: pair_represent_nodes_) {
+        const int id = arena[n].blockId;
+        bs_tree_.setShape(
+            arena,
+            n,
+            placement.GetRotatedWidth(id),
+            placement.GetRotatedHeight(id)
         );
     }
-    for (NodePointer n: self_represent_nodes_) {
-        int half_w = (group_->axis == Axis::kVertical) ?
-            blocks[n->blockId].GetRotatedWidth() / 2 :
-                blocks[n->blockId].GetRotatedWidth();
-        int half_h = (group_->axis == Axis::kHorizontal) ?
-            blocks[n->blockId].GetRotatedHeight() / 2 :
-                blocks[n->blockId].GetRotatedHeight();
-        n->setShape(half_w, half_h);
+    for (NodeIndex n: self_represent_nodes_) {
+        const int id = arena[n].blockId;
+        int half_w = (group_.axis == Axis::kVertical) ?
+            placement.GetRotatedWidth(id) / 2 :
+                placement.GetRotatedWidth(id);
+        int half_h = (group_.axis == Axis::kHorizontal) ?
+            placement.GetRotatedHeight(id) / 2 :
+                placement.GetRotatedHeight(id);
+        bs_tree_.setShape(arena, n, half_w, half_h);
     }
 }
 
-NodePointer AsfIsland::GetTreesRoot() {
-    if (pair_root_) {
+bool AsfIsland::SelfChainOnRchild() const {
+    // 垂直軸時 self 模組往上疊，接在 B*-tree 中放在上方的 child。
+    // 鏡射後左右子樹的角色互換，實際的連結要反過來
+    return (group_.axis == Axis::kVertical) != bs_tree_.isMirrored();
+}
+
+NodeIndex AsfIsland::GetTreesRoot() {
+    if (pair_root_ != nullNode) {
         return pair_root_;
     }
     return self_root_;
 }
 
-NodePointer AsfIsland::TryConnectTrees() {
-    if (!pair_root_) {
-        return nullptr;
+NodeIndex AsfIsland::TryConnectTrees(NodeArenaType &arena) {
+    if (pair_root_ == nullNode) {
+        return nullNode;
     }
-    NodePointer connect_node = pair_root_;
-   
-    if (group_->axis == Axis::kVertical) {
-       while (connect_node->rchild) {
-           connect_node = connect_node->rchild;
+    NodeIndex connect_node = pair_root_;
+
+    if (SelfChainOnRchild()) {
+       while (arena[connect_node].rchild != nullNode) {
+           connect_node = arena[connect_node].rchild;
        }
-       connect_node->rchild = self_root_;
+       arena[connect_node].rchild = self_root_;
     } else {
-       while (connect_node->lchild) {
-           connect_node = connect_node->lchild;
+       while (arena[connect_node].lchild != nullNode) {
+           connect_node = arena[connect_node].lchild;
        }
-       connect_node->lchild = self_root_;
+       arena[connect_node].lchild = self_root_;
+    }
+    if (self_root_ != nullNode) {
+        arena[self_root_].parent = connect_node;
+    }
+
+    // 上次 pack 時 self tree 接在別的節點下，連結已經改變
+    if (connect_node != last_connect_node_) {
+        bs_tree_.touch(arena, connect_node);
+        bs_tree_.touch(arena, self_root_);
+        last_connect_node_ = connect_node;
     }
     return connect_node;
 }
@@ -121,144 +153,165 @@ NodePointer AsfIsland::TryConnectTrees() {
  *             2) 鏡射 mate / self 模組  (式 (1)(2))
  *             3) 校正 bbox 置於 (0,0)
  ********************************************************************/
-std::int64_t AsfIsland::PackAndGetPenaltyArea(std::vector<Block>& blocks) {   
+std::int64_t AsfIsland::PackAndGetPenaltyArea(NodeArenaType &arena, Placement& placement) {
     /* ---------- 0) 打包代表半平面 ---------- */
-    UpdateNodes(blocks);
+    UpdateNodes(arena, placement);
 
-    NodePointer connect_node = TryConnectTrees();
+    NodeIndex connect_node = TryConnectTrees(arena);
     bs_tree_.root = GetTreesRoot();
-    bs_tree_.setPosition();
+    bs_tree_.setPosition(arena);
     std::int64_t full_area = bs_tree_.getArea() * 2;
     std::int64_t block_area = 0;
 
     /* ---------- 1) 掃描代表並鏡射 ---------- */
-    std::int64_t min_x = LLONG_MAX, min_y = LLONG_MAX;
-    std::int64_t max_x = LLONG_MIN, max_y = LLONG_MIN;
     axis_pos_ = 0;
-
-    std::stack<NodePointer> stk;
-    stk.emplace(bs_tree_.root);
-
-    while (!stk.empty()) {
-        NodePointer n = stk.top();
-        stk.pop();
-        Block& rep = blocks[n->blockId];
-
-        /* 1-a  設定代表座標 */
-        rep.x = n->x;
-        rep.y = n->y;
-
-        /* 1-b  處理 symmetry-pair 的另一半 */
-        auto pair_it = std::find_if(std::begin(group_->pairs), std::end(group_->pairs),
-                           [&](const SymmPair& p){ return p.bid == n->blockId; });
-        if (pair_it != std::end(group_->pairs)) {
-            int mate_id = pair_it->aid;
-            Block& mate = blocks[mate_id];
-            mate.rotated = rep.rotated;
-
-            if (group_->axis == Axis::kVertical) {
-                mate.x = 2 * axis_pos_ - rep.x - rep.GetRotatedWidth(); // 式 (1)
-                mate.y = rep.y;
+    const int num_pairs = group_.pairs.size();
+
+    // self tree 已經接在 pair tree 下，每個代表節點都剛 pack 過，順序不影響結果，
+    // 直接依照 all_represent_nodes_ 的順序走，不需要沿著樹走訪。座標寫到 block_ids_ 中
+    // 對應的位置：第 i 對 pair 的 a (mate) 與 b (代表) 在 2i 與 2i+1，self 接在後面
+    for (size_t i = 0; i < all_represent_nodes_.size(); ++i) {
+        const NodeType &n = arena[all_represent_nodes_[i]];
+        const int rep_id = n.blockId;
+        const int mate_id = mate_ids_[i];
+        const int rep_w = placement.GetRotatedWidth(rep_id);
+        const int rep_h = placement.GetRotatedHeight(rep_id);
+
+        /* 1-a  處理 symmetry-pair 的另一半 */
+        if (mate_id >= 0) {
+            const int rep = 2 * i + 1;
+            const int mate = 2 * i;
+            placement.SetRotated(mate_id, placement.IsRotated(rep_id));
+
+            local_x_[rep] = n.x;
+            local_y_[rep] = n.y;
+            if (group_.axis == Axis::kVertical) {
+                local_x_[mate] = 2 * axis_pos_ - n.x - rep_w; // 式 (1)
+                local_y_[mate] = n.y;
             } else {
-                mate.x = rep.x;
-                mate.y = 2 * axis_pos_ - rep.y - rep.GetRotatedHeight(); // 式 (2)
+                local_x_[mate] = n.x;
+                local_y_[mate] = 2 * axis_pos_ - n.y - rep_h; // 式 (2)
             }
+            local_w_[rep] = rep_w;
+            local_h_[rep] = rep_h;
+            local_w_[mate] = placement.GetRotatedWidth(mate_id);
+            local_h_[mate] = placement.GetRotatedHeight(mate_id);
 
             // 共兩個相同大小的方塊
-            block_area += rep.GetRotatedWidth() * rep.GetRotatedHeight() * 2;
-
-            // 也要把 mate 也納入 bounding‐box 更新
-            min_x = std::min<std::int64_t>(min_x, mate.x);
-            min_y = std::min<std::int64_t>(min_y, mate.y);
-            max_x = std::max<std::int64_t>(max_x, mate.x + mate.GetRotatedWidth());
-            max_y = std::max<std::int64_t>(max_y, mate.y + mate.GetRotatedHeight());
+            block_area += rep_w * rep_h * 2;
         }
 
-        /* 1-c  self-symmetric：置中於軸 */
-        auto self_it = std::find_if(std::begin(group_->selfs), std::end(group_->selfs),
-                           [&](const SymmSelf& s){ return s.id == n->blockId; });
-        if (self_it != std::end(group_->selfs)){
-            if( group_->axis == Axis::kVertical) {
-                rep.x = axis_pos_ - rep.GetRotatedWidth()/2; // 中心落在 x
+        /* 1-b  self-symmetric：置中於軸 */
+        if (mate_id < 0) {
+            const int rep = num_pairs + i;
+            if( group_.axis == Axis::kVertical) {
+                local_x_[rep] = axis_pos_ - rep_w/2; // 中心落在 x
+                local_y_[rep] = n.y;
             } else {
-                rep.y = axis_pos_ - rep.GetRotatedHeight()/2; // 中心落在 y
+                local_x_[rep] = n.x;
+                local_y_[rep] = axis_pos_ - rep_h/2; // 中心落在 y
             }
-            block_area += rep.GetRotatedWidth() * rep.GetRotatedHeight();
-        }
-
-        /* 1-d  更新 bounding box */
-        min_x = std::min<std::int64_t>(min_x, rep.x);
-        min_y = std::min<std::int64_t>(min_y, rep.y);
-        max_x = std::max<std::int64_t>(max_x, rep.x + rep.GetRotatedWidth());
-        max_y = std::max<std::int64_t>(max_y, rep.y + rep.GetRotatedHeight());
-
-        if (n->lchild) {
-            stk.emplace(n->lchild);
-        }
-        if (n->rchild) {
-            stk.emplace(n->rchild);
+            local_w_[rep] = rep_w;
+            local_h_[rep] = rep_h;
+            block_area += rep_w * rep_h;
         }
     }
 
-    /* ---------- 2) 平移全島到 (0,0) ---------- */
-    const std::int64_t dx = -min_x;
-    const std::int64_t dy = -min_y;
+    /* ---------- 2) 計算外框並平移全島到 (0,0) ---------- */
+    const int num_blocks = block_ids_.size();
+    const BoundingBox box = ComputeBoundingBox(local_x_.data(), local_y_.data(),
+                                               local_w_.data(), local_h_.data(), num_blocks);
+    const std::int64_t dx = -box.min_x;
+    const std::int64_t dy = -box.min_y;
+    TranslateCoords(local_x_.data(), num_blocks, dx);
+    TranslateCoords(local_y_.data(), num_blocks, dy);
 
-    for (int id: block_ids_) {
-        blocks[id].x += dx;
-        blocks[id].y += dy;
-    }
-
-    bbox_w_ = max_x - min_x;
-    bbox_h_ = max_y - min_y;
+    bbox_w_ = box.max_x - box.min_x;
+    bbox_h_ = box.max_y - box.min_y;
 
     // 根據對稱軸方向正確更新軸位置
-    if (group_->axis == Axis::kVertical) {
+    if (group_.axis == Axis::kVertical) {
         axis_pos_ += dx;  // 垂直對稱軸，x軸平移
     } else {
         axis_pos_ += dy;  // 水平對稱軸，y軸平移
     }
 
-    if (connect_node) {
-        if (group_->axis == Axis::kVertical) {
-           connect_node->rchild = nullptr;
+    if (connect_node != nullNode) {
+        if (SelfChainOnRchild()) {
+           arena[connect_node].rchild = nullNode;
         } else {
-           connect_node->lchild = nullptr;
+           arena[connect_node].lchild = nullNode;
+        }
+        if (self_root_ != nullNode) {
+            arena[self_root_].parent = nullNode;
         }
     }
     return full_area - block_area;
 }
 
-void AsfIsland::Mirror(std::vector<Block>& blocks) {
-    if (group_->axis == Axis::kVertical) {
-        group_->axis = Axis::kHorizontal;
+void AsfIsland::Place(Placement& placement, int dx, int dy) const {
+    // block id 不連續，只能逐一寫入，順便加上島在 HB-tree 中的位置
+    for (size_t k = 0; k < block_ids_.size(); ++k) {
+        placement.x[block_ids_[k]] = local_x_[k] + dx;
+        placement.y[block_ids_[k]] = local_y_[k] + dy;
+    }
+}
+
+void AsfIsland::Mirror(Placement& placement) {
+    if (group_.axis == Axis::kVertical) {
+        group_.axis = Axis::kHorizontal;
     } else {
-        group_->axis = Axis::kVertical;
+        group_.axis = Axis::kVertical;
     }
     for (auto id: block_ids_) {
-        blocks[id].Rotate();
+        placement.Rotate(id);
     }
-    MirrorTree(bs_tree_.root);
+    // 不必交換每個節點的 children，只要讓 B*-tree 反過來解讀左右子樹
+    bs_tree_.setMirrored(!bs_tree_.isMirrored());
+}
+
+void AsfIsland::SaveSnapshot(Snapshot &snap) const {
+    bs_tree_.save(snap.tree);
+    snap.tree_root = bs_tree_.root;
+    snap.pair_root = pair_root_;
+    snap.self_root = self_root_;
+    snap.last_connect_node = last_connect_node_;
+    snap.axis = group_.axis;
+    snap.bbox_w = bbox_w_;
+    snap.bbox_h = bbox_h_;
+    snap.axis_pos = axis_pos_;
+}
+
+void AsfIsland::RestoreSnapshot(const Snapshot &snap) {
+    bs_tree_.restore(snap.tree);
+    bs_tree_.root = snap.tree_root;
+    pair_root_ = snap.pair_root;
+    self_root_ = snap.self_root;
+    last_connect_node_ = snap.last_connect_node;
+    group_.axis = snap.axis;
+    bbox_w_ = snap.bbox_w;
+    bbox_h_ = snap.bbox_h;
+    axis_pos_ = snap.axis_pos;
 }
 
 int AsfIsland::GetNumberNodes() const {
     return all_represent_nodes_.size();
 }
 
-RotateNodeOp AsfIsland::RotateNodeRandomize(std::vector<Block>& blocks) {
+RotateNodeOp AsfIsland::RotateNodeRandomize(PRNG &rng, NodeArenaType &arena, Placement& placement) {
     RotateNodeOp op;
-    op.Apply(blocks, all_represent_nodes_);
+    op.Apply(rng, arena, placement, all_represent_nodes_);
     return op;
 }
 
-SwapNodeOp AsfIsland::SwapNodeRandomize() {
+SwapNodeOp AsfIsland::SwapNodeRandomize(PRNG &rng, NodeArenaType &arena) {
     SwapNodeOp op;
-    op.Apply(&pair_root_, pair_represent_nodes_);
+    op.Apply(rng, &arena, &bs_tree_, &pair_root_, pair_represent_nodes_);
     return op;
 }
 
-LeafMoveOp AsfIsland::MoveLeafNodeRandomize() {
+LeafMoveOp AsfIsland::MoveLeafNodeRandomize(PRNG &rng, NodeArenaType &arena) {
     LeafMoveOp op;
-    op.Apply(pair_root_);
+    op.Apply(rng, &arena, &bs_tree_, pair_root_);
     return op;
 }
@@ -10,42 +10,63 @@
 /* 代表一個 symmetry-island：用 BStarTree 打包「代表半邊」，再鏡射 */
 class AsfIsland {
 public:
-    AsfIsland(SymmGroup * g): group_(g) {}
+    /* 打包後的狀態，節點本身存在 HbTree 的 arena 裡，由 HbTree 一起保存 */
+    struct Snapshot {
+        TreeType::State tree;
+        NodeIndex tree_root, pair_root, self_root, last_connect_node;
+        Axis axis;
+        int bbox_w, bbox_h;
+        int axis_pos;
+    };
 
-    void Initialize(std::vector<Block> &blocks);
-    std::int64_t PackAndGetPenaltyArea(std::vector<Block>& blocks);
-    void GetPenalty(std::vector<Block>& blocks);
-    void BuildInitialSolution();
-    void UpdateNodes(const std::vector<Block>& blocks);
+    AsfIsland(const SymmGroup &g): group_(g) {}
 
-    void Mirror(std::vector<Block>& blocks);
+    // 所有節點都配置在外部傳入的 arena 中
+    void Initialize(NodeArenaType &arena, Placement &placement);
+    // pack 後島內的座標 (外框左下角為原點) 只存在島內，由 Place 寫到 placement
+    std::int64_t PackAndGetPenaltyArea(NodeArenaType &arena, Placement& placement);
+    void Place(Placement& placement, int dx, int dy) const;
+    void GetPenalty(Placement& placement);
+    void BuildInitialSolution(NodeArenaType &arena);
+    void UpdateNodes(NodeArenaType &arena, const Placement& placement);
+
+    void Mirror(Placement& placement);
+    void SaveSnapshot(Snapshot &snap) const;
+    void RestoreSnapshot(const Snapshot &snap);
     int GetNumberNodes() const;
 
-    RotateNodeOp RotateNodeRandomize(std::vector<Block>& blocks);
-    SwapNodeOp SwapNodeRandomize();
-    LeafMoveOp MoveLeafNodeRandomize();
+    RotateNodeOp RotateNodeRandomize(PRNG &rng, NodeArenaType &arena, Placement& placement);
+    SwapNodeOp SwapNodeRandomize(PRNG &rng, NodeArenaType &arena);
+    LeafMoveOp MoveLeafNodeRandomize(PRNG &rng, NodeArenaType &arena);
 
     inline int GetWidth() const { return bbox_w_; }
     inline int GetHeight() const { return bbox_h_; }
+    const SymmGroup& GetGroup() const { return group_; }
     const std::vector<int>& GetBlockIds() const { return block_ids_; }
 
 private:
-    NodePointer GetTreesRoot();
-    NodePointer TryConnectTrees();
+    bool SelfChainOnRchild() const;
+    NodeIndex GetTreesRoot();
+    NodeIndex TryConnectTrees(NodeArenaType &arena);
 
-    SymmGroup * group_;                       // 指回原對稱群
-    BStarTree<IdType> bs_tree_;               // 代表半邊的 BStarTree
+    SymmGroup group_;                         // 對稱群，Mirror 會改變它的軸
+    TreeType bs_tree_;                        // 代表半邊的 BStarTree
     
-    std::vector<int> block_ids_;              // 全部的 block id  
-    std::vector<std::pair<int,int>> contour_; // 代表半邊的 contour segments
+    std::vector<int> block_ids_;              // 全部的 block id，每對 pair 是 (a, b)，之後是 self
+    // 島內座標與旋轉後的寬高，與 block_ids_ 的順序相同，連續存放才能以 SIMD 計算外框與平移
+    std::vector<std::int32_t> local_x_, local_y_, local_w_, local_h_;
+
+    NodeIndexList pair_represent_nodes_;      // 代表半邊的對稱對點
+    NodeIndexList self_represent_nodes_;      // 代表半邊的字對稱點
+    NodeIndexList all_represent_nodes_;
 
-    NodePointerList pair_represent_nodes_;    // 代表半邊的對稱對點
-    NodePointerList self_represent_nodes_;    // 代表半邊的字對稱點
-    NodePointerList all_represent_nodes_;
+    // 以代表節點在 all_represent_nodes_ 中的位置當作索引
+    std::vector<int> mate_ids_;               // 對稱對的另一半，自對稱點為 -1
 
     int bbox_w_{0}, bbox_h_{0};               // 半邊外框
     int axis_pos_{0};                         // 垂直：x；水平：y
 
-    NodePointer pair_root_;
-    NodePointer self_root_;
+    NodeIndex pair_root_{nullNode};
+    NodeIndex self_root_{nullNode};
+    NodeIndex last_connect_node_{nullNode};   // 上次 pack 時 self tree 的接點
 };
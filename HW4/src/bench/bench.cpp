@@ -0,0 +1,334 @@
+/*
+ * 量測 SA 熱路徑上各個 kernel 的 ns/op，結果以 JSON 輸出到 stdout。
+ *
+ *     ./bench [in.txt ...]
+ *
+ * 除了命令列給的測資外，還會自動產生幾組合成測資。每個 kernel 先暖身，
+ * 再重複量測 kRepetitions 次，回報中位數與最小值。
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "asf_island.hpp"
+#include "geometry.hpp"
+#include "hb_tree.hpp"
+#include "input_reader.hpp"
+#include "placer.hpp"
+#include "tools/testcase_gen.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+#include "wirelength.hpp"
+
+namespace {
+
+constexpr int kRepetitions = 7;
+constexpr std::int64_t kWarmupNs = 50 * 1000 * 1000;
+constexpr std::int64_t kTargetNs = 100 * 1000 * 1000;
+
+volatile std::int64_t g_sink; // 避免被最佳化掉的計算結果
+
+/* 一組測資：所有 block 與對稱群 */
+struct BenchInput {
+    std::string name;
+    BlockTable table;
+    Placement placement;
+    std::vector<SymmGroup> groups;
+    std::string text; // 測資檔或產生出的測資的內容
+};
+
+struct KernelResult {
+    std::string name;
+    double ns_per_op;
+    double min_ns_per_op;
+    std::int64_t iterations;
+};
+
+std::int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* 執行 iters 次 fn，回傳總共的 ns */
+std::int64_t RunBatch(const std::function<void()> &fn, std::int64_t iters) {
+    const std::int64_t start = NowNs();
+    for (std::int64_t i = 0; i < iters; ++i) {
+        fn();
+    }
+    return NowNs() - start;
+}
+
+KernelResult Measure(const std::string &name, const std::function<void()> &fn) {
+    // 暖身並估計一次的時間，決定每次重複要跑幾次
+    std::int64_t iters = 1;
+    std::int64_t elapsed = 0;
+    std::int64_t total = 0;
+    while (total < kWarmupNs) {
+        elapsed = RunBatch(fn, iters);
+        total += elapsed;
+        if (elapsed < kWarmupNs / 10) {
+            iters *= 2;
+        }
+    }
+    const double est_ns = std::max(1.0, (double)elapsed / iters);
+    iters = std::max<std::int64_t>(1, kTargetNs / kRepetitions / est_ns);
+
+    std::vector<double> samples;
+    for (int r = 0; r < kRepetitions; ++r) {
+        samples.emplace_back((double)RunBatch(fn, iters) / iters);
+    }
+    std::sort(samples.begin(), samples.end());
+    return {name, samples[kRepetitions / 2], samples.front(), iters * kRepetitions};
+}
+
+/* 以 gen_testcase 的產生器產生 num_blocks 個 block，num_groups 個對稱群各有
+   group_size 個 block，其中 num_selfs 個是自對稱 */
+BenchInput MakeSynthetic(int num_blocks, int num_groups, int group_size, int num_selfs,
+                         std::uint64_t seed) {
+    GenOptions options;
+    options.num_blocks = num_blocks;
+    options.num_groups = num_groups;
+    options.group_min = group_size;
+    options.group_max = group_size;
+    options.self_frac = (double)num_selfs / group_size;
+    options.min_size = 10;
+    options.max_size = 100;
+    options.seed = seed;
+
+    BenchInput input;
+    input.name = "synthetic" + std::to_string(num_blocks);
+    input.text = GenerateTestcase(options);
+    ProblemInput problem = ParseProblem(input.text, input.name);
+    input.table = std::move(problem.table);
+    input.placement = std::move(problem.placement);
+    input.groups = std::move(problem.groups);
+    return input;
+}
+
+BenchInput LoadFile(const std::string &path) {
+    Placer placer;
+    placer.ReadFile(path);
+
+    BenchInput input;
+    input.name = path.substr(path.find_last_of('/') + 1);
+    std::ifstream fin(path);
+    input.text.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    input.table = placer.GetBlockTable();
+    input.placement = placer.GetPlacement();
+    input.groups = placer.GetGroups();
+    return input;
+}
+
+std::vector<KernelResult> RunKernels(const BenchInput &input) {
+    std::vector<KernelResult> results;
+    PRNG rng(12345);
+
+    /* 讀檔：從記憶體中的內容解析，不包含讀取磁碟的時間 */
+    if (!input.text.empty()) {
+        results.emplace_back(Measure("parse_input", [&]() {
+            g_sink = ParseProblem(input.text, input.name).table.Size();
+        }));
+    }
+
+    /* BStarTree::setPosition：所有 block 組成的平衡樹 */
+    {
+        NodeArenaType arena;
+        NodeIndexList nodes;
+        for (int i = 0; i < input.table.Size(); ++i) {
+            nodes.emplace_back(arena.create());
+            arena[nodes.back()].blockId = i;
+            arena[nodes.back()].setShape(input.placement.GetRotatedWidth(i),
+                                         input.placement.GetRotatedHeight(i));
+        }
+        TreeType tree;
+        tree.root = BuildBalancedTree(arena, nodes);
+
+        results.emplace_back(Measure("bstar_set_position_full", [&]() {
+            tree.invalidate();
+            tree.setPosition(arena);
+            g_sink = tree.getArea();
+        }));
+        results.emplace_back(Measure("bstar_set_position_touch_one", [&]() {
+            tree.touch(arena, nodes[rng.RandInt(0, (int)nodes.size() - 1)]);
+            tree.setPosition(arena);
+            g_sink = tree.getArea();
+        }));
+    }
+
+    /* AsfIsland::PackAndGetPenaltyArea：最大的對稱群 */
+    if (!input.groups.empty()) {
+        auto largest = std::max_element(input.groups.begin(), input.groups.end(),
+            [](const SymmGroup &a, const SymmGroup &b) {
+                return a.pairs.size() + a.selfs.size() < b.pairs.size() + b.selfs.size();
+            });
+        NodeArenaType arena;
+        Placement placement = input.placement;
+        AsfIsland island(*largest);
+        island.Initialize(arena, placement);
+        island.PackAndGetPenaltyArea(arena, placement);
+
+        results.emplace_back(Measure("island_pack", [&]() {
+            g_sink = island.PackAndGetPenaltyArea(arena, placement);
+        }));
+        results.emplace_back(Measure("island_mirror_pack", [&]() {
+            island.Mirror(placement);
+            g_sink = island.PackAndGetPenaltyArea(arena, placement);
+        }));
+    }
+
+    /* HbTree：整體 pack、快照與擾動 */
+    HbTree hb_tree;
+    Placement placement = input.placement;
+    hb_tree.Initialize(input.table, placement, input.groups);
+    hb_tree.Pack(placement);
+    HbTree::Snapshot snapshot;
+    hb_tree.SaveSnapshot(placement, snapshot);
+
+    results.emplace_back(Measure("hbtree_pack_clean", [&]() {
+        g_sink = hb_tree.Pack(placement).area;
+    }));
+    results.emplace_back(Measure("hbtree_snapshot_save", [&]() {
+        hb_tree.SaveSnapshot(placement, snapshot);
+    }));
+    results.emplace_back(Measure("hbtree_snapshot_restore", [&]() {
+        hb_tree.RestoreSnapshot(placement, snapshot);
+    }));
+
+    const int num_nodes = hb_tree.GetNumberNodes();
+    results.emplace_back(Measure("move_rotate_pack_restore", [&]() {
+        hb_tree.RotateNode(placement, rng.RandInt(0, num_nodes - 1));
+        g_sink = hb_tree.Pack(placement).area;
+        hb_tree.RestoreSnapshot(placement, snapshot);
+    }));
+    results.emplace_back(Measure("move_swap_pack_restore", [&]() {
+        hb_tree.SwapNodeRandomize(rng);
+        g_sink = hb_tree.Pack(placement).area;
+        hb_tree.RestoreSnapshot(placement, snapshot);
+    }));
+    results.emplace_back(Measure("move_leaf_pack_restore", [&]() {
+        hb_tree.MoveLeafNodeRandomize(rng);
+        g_sink = hb_tree.Pack(placement).area;
+        hb_tree.RestoreSnapshot(placement, snapshot);
+    }));
+
+    /* 只有擾動本身，套用後立刻 Undo */
+    results.emplace_back(Measure("op_swap_apply_undo", [&]() {
+        SwapNodeOp op = hb_tree.SwapNodeRandomize(rng);
+        op.Undo();
+    }));
+    results.emplace_back(Measure("op_leaf_move_apply_undo", [&]() {
+        LeafMoveOp op = hb_tree.MoveLeafNodeRandomize(rng);
+        if (op.Valid()) {
+            op.Undo();
+        }
+    }));
+    hb_tree.RestoreSnapshot(placement, snapshot);
+
+    /* 幾何 kernel：整份 placement 的外框與平移在每種 CPU 支援的實作上各量一次，
+       結果必須與純量版本相同；重疊檢查量的是 pack 好的合法擺放 */
+    {
+        const int n = placement.Size();
+        std::vector<std::int32_t> w(n), h(n);
+        for (int i = 0; i < n; ++i) {
+            w[i] = placement.GetRotatedWidth(i);
+            h[i] = placement.GetRotatedHeight(i);
+        }
+        SetSimdLevel(SimdLevel::kScalar);
+        const BoundingBox expected = ComputeBoundingBox(placement.x.data(), placement.y.data(),
+                                                        w.data(), h.data(), n);
+        for (const SimdLevel level: {SimdLevel::kScalar, SimdLevel::kSse41, SimdLevel::kAvx2}) {
+            if (SetSimdLevel(level) != level) {
+                continue;
+            }
+            const std::string name = GetSimdLevelName(level);
+            const BoundingBox box = ComputeBoundingBox(placement.x.data(), placement.y.data(),
+                                                       w.data(), h.data(), n);
+            if (box.min_x != expected.min_x || box.min_y != expected.min_y ||
+                    box.max_x != expected.max_x || box.max_y != expected.max_y) {
+                std::cerr << "[ERROR] bounding box of " << name << " differs from scalar\n";
+            }
+            results.emplace_back(Measure("bbox_" + name, [&]() {
+                g_sink = ComputeBoundingBox(placement.x.data(), placement.y.data(),
+                                            w.data(), h.data(), n).max_x;
+            }));
+            std::vector<std::int32_t> coords = placement.x;
+            results.emplace_back(Measure("translate_" + name, [&]() {
+                TranslateCoords(coords.data(), n, 1);
+            }));
+        }
+        ResetSimdLevel();
+
+        if (FindOverlap(placement.x.data(), placement.y.data(), w.data(), h.data(), n).first >= 0) {
+            std::cerr << "[ERROR] packed placement of " << input.name << " has overlaps\n";
+        }
+        results.emplace_back(Measure("find_overlap", [&]() {
+            g_sink = FindOverlap(placement.x.data(), placement.y.data(),
+                                 w.data(), h.data(), n).first;
+        }));
+    }
+
+    /* WirelengthEvaluator::Compute：排序已經是最新的，以及移動一個 block 之後 */
+    {
+        WirelengthEvaluator wirelength;
+        wirelength.Compute(placement);
+        results.emplace_back(Measure("wirelength_sorted", [&]() {
+            g_sink = wirelength.Compute(placement);
+        }));
+
+        Placement moved = placement;
+        results.emplace_back(Measure("wirelength_move_one", [&]() {
+            const int id = rng.RandInt(0, moved.Size() - 1);
+            moved.x[id] = placement.x[rng.RandInt(0, moved.Size() - 1)];
+            g_sink = wirelength.Compute(moved);
+        }));
+    }
+    return results;
+}
+
+void PrintJson(const std::vector<BenchInput> &inputs,
+               const std::vector<std::vector<KernelResult>> &all_results) {
+    std::cout << "{\n  \"repetitions\": " << kRepetitions << ",\n  \"cases\": [\n";
+    for (size_t c = 0; c < inputs.size(); ++c) {
+        std::cout << "    {\n"
+                  << "      \"case\": \"" << inputs[c].name << "\",\n"
+                  << "      \"blocks\": " << inputs[c].table.Size() << ",\n"
+                  << "      \"groups\": " << inputs[c].groups.size() << ",\n"
+                  << "      \"kernels\": [\n";
+        const auto &results = all_results[c];
+        for (size_t k = 0; k < results.size(); ++k) {
+            std::cout << "        {\"name\": \"" << results[k].name << "\""
+                      << ", \"ns_per_op\": " << (std::int64_t)results[k].ns_per_op
+                      << ", \"min_ns_per_op\": " << (std::int64_t)results[k].min_ns_per_op
+                      << ", \"iterations\": " << results[k].iterations << "}"
+                      << (k + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "      ]\n    }" << (c + 1 < inputs.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, const char ** argv) {
+    std::vector<BenchInput> inputs;
+    for (int i = 1; i < argc; ++i) {
+        inputs.emplace_back(LoadFile(argv[i]));
+    }
+    inputs.emplace_back(MakeSynthetic(1000, 8, 36, 4, 1));
+    inputs.emplace_back(MakeSynthetic(5000, 16, 136, 8, 2));
+
+    std::vector<std::vector<KernelResult>> all_results;
+    for (const auto &input: inputs) {
+        std::cerr << "[INFO] bench " << input.name << "\n";
+        all_results.emplace_back(RunKernels(input));
+    }
+    PrintJson(inputs, all_results);
+    return 0;
+}
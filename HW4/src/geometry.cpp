@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include "geometry.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PLACER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr std::int32_t kInt32Max = std::numeric_limits<std::int32_t>::max();
+constexpr std::int32_t kInt32Min = std::numeric_limits<std::int32_t>::min();
+
+/* 純量版本，也用來處理向量版本剩下不足一個向量的部份 */
+void BoundingBoxTail(const std::int32_t *x, const std::int32_t *y,
+                     const std::int32_t *w, const std::int32_t *h,
+                     int begin, int end, BoundingBox &box) {
+    for (int i = begin; i < end; ++i) {
+        box.min_x = std::min(box.min_x, x[i]);
+        box.min_y = std::min(box.min_y, y[i]);
+        box.max_x = std::max(box.max_x, x[i] + w[i]);
+        box.max_y = std::max(box.max_y, y[i] + h[i]);
+    }
+}
+
+BoundingBox BoundingBoxScalar(const std::int32_t *x, const std::int32_t *y,
+                              const std::int32_t *w, const std::int32_t *h, int n) {
+    BoundingBox box{kInt32Max, kInt32Max, kInt32Min, kInt32Min};
+    BoundingBoxTail(x, y, w, h, 0, n, box);
+    return box;
+}
+
+void TranslateScalar(std::int32_t *v, int n, std::int32_t d) {
+    for (int i = 0; i < n; ++i) {
+        v[i] += d;
+    }
+}
+
+#ifdef PLACER_X86_SIMD
+// 以 target attribute 個別開啟指令集，其他部份仍然照一般的選項編譯，
+// 不支援的 CPU 不會執行到這些函式
+
+__attribute__((target("avx2")))
+BoundingBox BoundingBoxAvx2(const std::int32_t *x, const std::int32_t *y,
+                            const std::int32_t *w, const std::int32_t *h, int n) {
+    __m256i min_x = _mm256_set1_epi32(kInt32Max);
+    __m256i min_y = _mm256_set1_epi32(kInt32Max);
+    __m256i max_x = _mm256_set1_epi32(kInt32Min);
+    __m256i max_y = _mm256_set1_epi32(kInt32Min);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i vx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + i));
+        const __m256i vy = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(y + i));
+        const __m256i vw = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(w + i));
+        const __m256i vh = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i));
+        min_x = _mm256_min_epi32(min_x, vx);
+        min_y = _mm256_min_epi32(min_y, vy);
+        max_x = _mm256_max_epi32(max_x, _mm256_add_epi32(vx, vw));
+        max_y = _mm256_max_epi32(max_y, _mm256_add_epi32(vy, vh));
+    }
+    alignas(32) std::int32_t lanes[4][8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[0]), min_x);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[1]), min_y);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[2]), max_x);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[3]), max_y);
+    // 接下來呼叫的純量程式碼不是以 VEX 編碼，ymm 的上半部沒有清掉時每個 SSE 指令
+    // 都要付出轉換的代價，gcc 不會在呼叫前自動加上 vzeroupper
+    _mm256_zeroupper();
+    BoundingBox box{kInt32Max, kInt32Max, kInt32Min, kInt32Min};
+    for (int k = 0; k < 8; ++k) {
+        box.min_x = std::min(box.min_x, lanes[0][k]);
+        box.min_y = std::min(box.min_y, lanes[1][k]);
+        box.max_x = std::max(box.max_x, lanes[2][k]);
+        box.max_y = std::max(box.max_y, lanes[3][k]);
+    }
+    BoundingBoxTail(x, y, w, h, i, n, box);
+    return box;
+}
+
+__attribute__((target("avx2")))
+void TranslateAvx2(std::int32_t *v, int n, std::int32_t d) {
+    const __m256i vd = _mm256_set1_epi32(d);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i *p = reinterpret_cast<__m256i *>(v + i);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), vd));
+    }
+    _mm256_zeroupper();
+    TranslateScalar(v + i, n - i, d);
+}
+
+__attribute__((target("sse4.1")))
+BoundingBox BoundingBoxSse41(const std::int32_t *x, const std::int32_t *y,
+                             const std::int32_t *w, const std::int32_t *h, int n) {
+    __m128i min_x = _mm_set1_epi32(kInt32Max);
+    __m128i min_y = _mm_set1_epi32(kInt32Max);
+    __m128i max_x = _mm_set1_epi32(kInt32Min);
+    __m128i max_y = _mm_set1_epi32(kInt32Min);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i vx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i));
+        const __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + i));
+        const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(w + i));
+        const __m128i vh = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+        min_x = _mm_min_epi32(min_x, vx);
+        min_y = _mm_min_epi32(min_y, vy);
+        max_x = _mm_max_epi32(max_x, _mm_add_epi32(vx, vw));
+        max_y = _mm_max_epi32(max_y, _mm_add_epi32(vy, vh));
+    }
+    alignas(16) std::int32_t lanes[4][4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[0]), min_x);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[1]), min_y);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[2]), max_x);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[3]), max_y);
+    BoundingBox box{kInt32Max, kInt32Max, kInt32Min, kInt32Min};
+    for (int k = 0; k < 4; ++k) {
+        box.min_x = std::min(box.min_x, lanes[0][k]);
+        box.min_y = std::min(box.min_y, lanes[1][k]);
+        box.max_x = std::max(box.max_x, lanes[2][k]);
+        box.max_y = std::max(box.max_y, lanes[3][k]);
+    }
+    BoundingBoxTail(x, y, w, h, i, n, box);
+    return box;
+}
+
+__attribute__((target("sse4.1")))
+void TranslateSse41(std::int32_t *v, int n, std::int32_t d) {
+    const __m128i vd = _mm_set1_epi32(d);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i *p = reinterpret_cast<__m128i *>(v + i);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), vd));
+    }
+    TranslateScalar(v + i, n - i, d);
+}
+#endif
+
+/*
+ * 目前選擇的實作。ymm 指令與一般以 SSE 編碼的程式碼交錯執行時，每次進入 AVX2
+ * 的 kernel 都要多花約 200 ns (Xeon 上實測，與長度無關)，島內只有幾十個 block
+ * 時遠大於 kernel 本身。陣列夠長時兩者都受限於記憶體頻寬，AVX2 也只和 SSE4.1
+ * 差不多，所以自動選擇時只有長度超過 kMinWideSize 才使用 AVX2
+ */
+constexpr int kMinWideSize = 16384;
+
+struct Kernels {
+    SimdLevel level;
+    int min_wide_size;   // 長度至少這麼長才使用 wide 的實作
+    BoundingBox (*bounding_box)(const std::int32_t *, const std::int32_t *,
+                                const std::int32_t *, const std::int32_t *, int);
+    void (*translate)(std::int32_t *, int, std::int32_t);
+    BoundingBox (*bounding_box_wide)(const std::int32_t *, const std::int32_t *,
+                                     const std::int32_t *, const std::int32_t *, int);
+    void (*translate_wide)(std::int32_t *, int, std::int32_t);
+};
+
+SimdLevel GetSupportedLevel() {
+#ifdef PLACER_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::kAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SimdLevel::kSse41;
+    }
+#endif
+    return SimdLevel::kScalar;
+}
+
+// 只使用 level 這一種實作
+Kernels MakeKernels(SimdLevel level) {
+    switch (level) {
+#ifdef PLACER_X86_SIMD
+        case SimdLevel::kAvx2:
+            return {level, 0, BoundingBoxAvx2, TranslateAvx2, BoundingBoxAvx2, TranslateAvx2};
+        case SimdLevel::kSse41:
+            return {level, 0, BoundingBoxSse41, TranslateSse41, BoundingBoxSse41, TranslateSse41};
+#endif
+        default:
+            return {SimdLevel::kScalar, 0, BoundingBoxScalar, TranslateScalar,
+                    BoundingBoxScalar, TranslateScalar};
+    }
+}
+
+// 自動選擇：短的陣列用 SSE4.1，長的陣列才用 AVX2
+Kernels MakeDefaultKernels() {
+    const SimdLevel supported = GetSupportedLevel();
+    if (supported != SimdLevel::kAvx2) {
+        return MakeKernels(supported);
+    }
+    Kernels kernels = MakeKernels(SimdLevel::kSse41);
+    const Kernels wide = MakeKernels(SimdLevel::kAvx2);
+    kernels.level = SimdLevel::kAvx2;
+    kernels.min_wide_size = kMinWideSize;
+    kernels.bounding_box_wide = wide.bounding_box;
+    kernels.translate_wide = wide.translate;
+    return kernels;
+}
+
+Kernels &GetKernels() {
+    static Kernels kernels = MakeDefaultKernels();
+    return kernels;
+}
+
+} // namespace
+
+SimdLevel GetSimdLevel() {
+    return GetKernels().level;
+}
+
+SimdLevel SetSimdLevel(SimdLevel level) {
+    level = std::min(level, GetSupportedLevel());
+    GetKernels() = MakeKernels(level);
+    return level;
+}
+
+void ResetSimdLevel() {
+    GetKernels() = MakeDefaultKernels();
+}
+
+const char *GetSimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::kAvx2: return "avx2";
+        case SimdLevel::kSse41: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+BoundingBox ComputeBoundingBox(const std::int32_t *x, const std::int32_t *y,
+                               const std::int32_t *w, const std::int32_t *h, int n) {
+    const Kernels &kernels = GetKernels();
+    if (n >= kernels.min_wide_size) {
+        return kernels.bounding_box_wide(x, y, w, h, n);
+    }
+    return kernels.bounding_box(x, y, w, h, n);
+}
+
+void TranslateCoords(std::int32_t *v, int n, std::int32_t d) {
+    const Kernels &kernels = GetKernels();
+    if (n >= kernels.min_wide_size) {
+        kernels.translate_wide(v, n, d);
+    } else {
+        kernels.translate(v, n, d);
+    }
+}
+
+std::pair<int, int> FindOverlap(const std::int32_t *x, const std::int32_t *y,
+                                const std::int32_t *w, const std::int32_t *h, int n) {
+    // 由左往右掃，矩形的左邊加入、右邊移出。同一個 x 上先移出再加入，
+    // 只有邊相接的矩形不會同時在集合中
+    struct Event {
+        std::int64_t x;
+        int insert; // 0 移出，1 加入
+        int id;
+    };
+    std::vector<Event> events;
+    events.reserve(2 * (size_t)n);
+    for (int i = 0; i < n; ++i) {
+        events.push_back({x[i], 1, i});
+        events.push_back({(std::int64_t)x[i] + w[i], 0, i});
+    }
+    std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+        return a.x != b.x ? a.x < b.x : a.insert < b.insert;
+    });
+
+    // 掃描線上的矩形依照下緣排序。加入前集合中的 y 區間兩兩不相交，新的矩形
+    // 如果和其中一個重疊，一定會和排序上緊鄰它的前一個或後一個重疊
+    std::set<std::pair<std::int64_t, int>> active;
+    for (const Event &e: events) {
+        const std::pair<std::int64_t, int> key{y[e.id], e.id};
+        if (!e.insert) {
+            active.erase(key);
+            continue;
+        }
+        const std::int64_t top = (std::int64_t)y[e.id] + h[e.id];
+        auto next = active.lower_bound(key);
+        if (next != active.end() && next->first < top) {
+            return {next->second, e.id};
+        }
+        if (next != active.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + h[prev->second] > key.first) {
+                return {prev->second, e.id};
+            }
+        }
+        active.insert(next, key);
+    }
+    return {-1, -1};
+}
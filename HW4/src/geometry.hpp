@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+/*
+ * 攤平成陣列的矩形座標上的幾何 kernel。外框與平移有 AVX2、SSE4.1 與純量三種
+ * 實作，第一次呼叫時依照 CPU 選擇，三種的結果完全相同。支援 AVX2 時也只有很長
+ * 的陣列才使用 AVX2，原因見 geometry.cpp。
+ * 矩形 i 佔據 [x[i], x[i] + w[i]) x [y[i], y[i] + h[i])，寬高都必須是正的。
+ */
+
+enum class SimdLevel {
+    kScalar,
+    kSse41,
+    kAvx2
+};
+
+/* 一群矩形的外框，沒有矩形時 min 為 INT32_MAX、max 為 INT32_MIN */
+struct BoundingBox {
+    std::int32_t min_x, min_y;
+    std::int32_t max_x, max_y; // 右上角 (x + w, y + h) 的最大值
+};
+
+// CPU 支援的最高等級，或是 SetSimdLevel 指定的等級
+SimdLevel GetSimdLevel();
+
+// 不論長度都強制使用某一種實作 (給 benchmark 比較用)，CPU 不支援時改用它支援的
+// 最高等級，回傳實際使用的等級。ResetSimdLevel 回到自動選擇。兩者都不是
+// thread-safe，只能在開始計算前呼叫
+SimdLevel SetSimdLevel(SimdLevel level);
+void ResetSimdLevel();
+
+const char *GetSimdLevelName(SimdLevel level);
+
+BoundingBox ComputeBoundingBox(const std::int32_t *x, const std::int32_t *y,
+                               const std::int32_t *w, const std::int32_t *h, int n);
+
+// v[i] += d
+void TranslateCoords(std::int32_t *v, int n, std::int32_t d);
+
+// 以 sweep line 在 O(N log N) 內找出一對重疊的矩形，只有邊相接不算重疊。
+// 沒有重疊時回傳 {-1, -1}
+std::pair<int, int> FindOverlap(const std::int32_t *x, const std::int32_t *y,
+                                const std::int32_t *w, const std::int32_t *h, int n);
@@ -2,25 +2,25 @@
 #include <cmath>
 #include "hb_tree.hpp"
 
-void HbTree::Initialize(std::vector<Block> &blocks,
-                        std::vector<SymmGroup> &groups) {
+void HbTree::Initialize(const BlockTable &table,
+                        Placement &placement,
+                        const std::vector<SymmGroup> &groups) {
 
-    const int bsize = blocks.size();
+    const int bsize = table.Size();
     for (int i = 0; i < bsize; ++i) {
-        auto &block = blocks[i];
-        if (block.IsSolo()) {
-            solo_nodes_.emplace_back(new NodeType());
-            solo_nodes_.back()->blockId = i;
+        if (table.IsSolo(i)) {
+            solo_nodes_.emplace_back(arena_.create());
+            arena_[solo_nodes_.back()].blockId = i;
         }
     }
     const int gsize = groups.size();
     for (int i = 0; i < gsize; ++i) {
         auto &group = groups[i];
-        hier_nodes_.emplace_back(new NodeType());
-        hier_nodes_.back()->blockId = i;
+        hier_nodes_.emplace_back(arena_.create());
+        arena_[hier_nodes_.back()].blockId = i;
 
-        islands_.emplace_back(std::make_unique<AsfIsland>(&group));
-        islands_.back()->Initialize(blocks);
+        islands_.emplace_back(group);
+        islands_.back().Initialize(arena_, placement);
     }
 
     all_nodes_.reserve(solo_nodes_.size() + hier_nodes_.size());
@@ -29,74 +29,93 @@ void HbTree::Initialize(std::vector<Block> &blocks,
     all_nodes_.insert(std::end(all_nodes_),
         std::begin(hier_nodes_), std::end(hier_nodes_));
 
-    UpdateNodes(blocks);
+    UpdateNodes(placement);
     BuildInitialSolution();
 }
 
-void HbTree::UpdateNodes(const std::vector<Block> &blocks) {
-    for (NodePointer n: solo_nodes_) {
-        auto &block = blocks[n->blockId];
-        n->setShape(
-            block.GetRotatedWidth(),
-            block.GetRotatedHeight()
+void HbTree::UpdateNodes(const Placement &placement) {
+    for (NodeIndex n: solo_nodes_) {
+        const int id = arena_[n].blockId;
+        bs_tree_.setShape(
+            arena_,
+            n,
+            placement.GetRotatedWidth(id),
+            placement.GetRotatedHeight(id)
         );
     }
-    for (NodePointer n: hier_nodes_) {
-        auto &island = islands_[n->blockId];
-        n->setShape(
-            island->GetWidth(),
-            island->GetHeight()
+    for (NodeIndex n: hier_nodes_) {
+        const auto &island = islands_[arena_[n].blockId];
+        bs_tree_.setShape(
+            arena_,
+            n,
+            island.GetWidth(),
+            island.GetHeight()
         );
     }
 }
 
 void HbTree::BuildInitialSolution() {
-    NodePointerList sorted = all_nodes_;
+    NodeIndexList sorted = all_nodes_;
     std::sort(sorted.begin(), sorted.end(),
-              [](auto a, auto b){
-                  return a->width * a->height > b->width * b->height;
+              [&](NodeIndex a, NodeIndex b){
+                  return arena_[a].width * arena_[a].height >
+                             arena_[b].width * arena_[b].height;
               });
-    bs_tree_.root = BuildLeftSkewedTree(sorted);
+    bs_tree_.root = BuildLeftSkewedTree(arena_, sorted);
+    bs_tree_.reserve(all_nodes_.size());
+    bs_tree_.trackSlots(arena_, all_nodes_);
+    bs_tree_.invalidate();
 }
 
-std::int64_t HbTree::PackAndGetArea(std::vector<Block> &blocks, double penalty_factor) {
+PackResult HbTree::Pack(Placement &placement) {
     // 重新 pack 每個 island 內部 （如果 island 內部也要重新 SA 擾動）
     std::int64_t penalty_area = 0;
     for (auto &island: islands_) {
-        penalty_area += island->PackAndGetPenaltyArea(blocks);
+        penalty_area += island.PackAndGetPenaltyArea(arena_, placement);
     }
-    penalty_area = std::round<std::int64_t>(penalty_factor * penalty_area);
 
     // 1. 用 B*-Tree 計算全局 (x,y)
-    UpdateNodes(blocks);
-    bs_tree_.setPosition();
+    UpdateNodes(placement);
+    bs_tree_.setPosition(arena_);
 
     // 2. 把每個 symmetry island 的 local pack 結果平移到全局座標
     //    hier_nodes_[i] 對應 islands_[i]
     for (size_t i = 0; i < hier_nodes_.size(); ++i) {
-        NodePointer n = hier_nodes_[i];
-        std::int64_t dx = n->x;
-        std::int64_t dy = n->y;
-        // 每個 ASFIsland 內部都已經在 pack() 時設定好 local (0,0) 開始的
-        // blocks 座標，我們只要把它們往 (dx,dy) 平移就能到全局位置
-        for (const auto& id: islands_[i]->GetBlockIds()) {
-            // 假設 ASFIsland 暴露了一個 map<string,int> 叫 localIdxMap
-            // 其 value 就是對應到全域 blocks 的索引
-            blocks[id].x += dx;
-            blocks[id].y += dy;
-        }
+        const NodeType &n = arena_[hier_nodes_[i]];
+        islands_[i].Place(placement, n.x, n.y);
     }
 
     // 3. 放 solo blocks
     //    solo_nodes_[i] 對應 solo_ids[i]
     for (size_t i = 0; i < solo_nodes_.size(); ++i) {
-        NodePointer n = solo_nodes_[i];
-        blocks[n->blockId].x = n->x;
-        blocks[n->blockId].y = n->y;
+        const NodeType &n = arena_[solo_nodes_[i]];
+        placement.x[n.blockId] = n.x;
+        placement.y[n.blockId] = n.y;
     }
 
-    // 4. 回傳整個排版面積
-    return bs_tree_.getArea() + penalty_area;
+    // 4. 回傳整個排版面積與線長
+    return {bs_tree_.getArea(), penalty_area, wirelength_.Compute(placement)};
+}
+
+void HbTree::SaveSnapshot(const Placement &placement, Snapshot &snap) const {
+    snap.arena = arena_;
+    bs_tree_.save(snap.tree);
+    snap.root = bs_tree_.root;
+    snap.islands.resize(islands_.size());
+    for (size_t i = 0; i < islands_.size(); ++i) {
+        islands_[i].SaveSnapshot(snap.islands[i]);
+    }
+    snap.placement = placement;
+}
+
+void HbTree::RestoreSnapshot(Placement &placement, const Snapshot &snap) {
+    arena_ = snap.arena;
+    bs_tree_.restore(snap.tree);
+    bs_tree_.root = snap.root;
+    for (size_t i = 0; i < islands_.size(); ++i) {
+        islands_[i].RestoreSnapshot(snap.islands[i]);
+    }
+    placement = snap.placement;
 }
 
 int HbTree::GetNumberNodes() const {
@@ -107,7 +126,7 @@ bool HbTree::IsSoloNode(const int idx) const {
     return idx < (int)solo_nodes_.size();
 }
 
-NodePointer HbTree::GetNode(int idx) {
+NodeIndex HbTree::GetNode(int idx) const {
     if (idx < (int)solo_nodes_.size()) {
         return solo_nodes_[idx];
     }
@@ -115,35 +134,47 @@ NodePointer HbTree::GetNode(int idx) {
     if (idx < (int)hier_nodes_.size()) {
         return hier_nodes_[idx];
     }
-    return nullptr;
+    return nullNode;
 }
 
-AsfIsland * HbTree::GetIsland(int idx) {
+const AsfIsland * HbTree::GetIsland(int idx) const {
     if (idx < (int)islands_.size()) {
-        return islands_[idx].get();
+        return &islands_[idx];
     }
     return nullptr;
 }
 
-void HbTree::RotateNode(std::vector<Block> &blocks, const int idx) {
-    NodePointer n = GetNode(idx);
+void HbTree::RotateNode(Placement &placement, const int idx) {
+    const int id = arena_[GetNode(idx)].blockId;
 
     if (IsSoloNode(idx)) {
-        blocks[n->blockId].Rotate();
+        placement.Rotate(id);
     } else {
-        islands_[n->blockId]->Mirror(blocks);
+        islands_[id].Mirror(placement);
     }
 }
 
-SwapNodeOp HbTree::SwapNodeRandomize() {
+SwapNodeOp HbTree::SwapNodeRandomize(PRNG &rng) {
     SwapNodeOp op;
-    op.Apply(&bs_tree_.root, all_nodes_);
+    op.Apply(rng, &arena_, &bs_tree_, &bs_tree_.root, all_nodes_);
     return op;
 }
 
-LeafMoveOp HbTree::MoveLeafNodeRandomize() {
+LeafMoveOp HbTree::MoveLeafNodeRandomize(PRNG &rng) {
     LeafMoveOp op;
-    op.Apply(bs_tree_.root);
+    op.Apply(rng, &arena_, &bs_tree_, bs_tree_.root);
     return op;
 }
 
+RotateNodeOp HbTree::RotateIslandNodeRandomize(PRNG &rng, Placement &placement, int idx) {
+    return islands_[idx].RotateNodeRandomize(rng, arena_, placement);
+}
+
+SwapNodeOp HbTree::SwapIslandNodeRandomize(PRNG &rng, int idx) {
+    return islands_[idx].SwapNodeRandomize(rng, arena_);
+}
+
+LeafMoveOp HbTree::MoveIslandLeafNodeRandomize(PRNG &rng, int idx) {
+    return islands_[idx].MoveLeafNodeRandomize(rng, arena_);
+}
+
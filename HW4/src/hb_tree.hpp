@@ -1,40 +1,66 @@
 #pragma once
 #include <cstdint>
 #include <vector>
-#include <memory>
 
 #include "BStarTree.hpp"
 #include "asf_island.hpp"
 #include "utils.hpp"
 #include "types.hpp"
+#include "wirelength.hpp"
+
+/* 一次 pack 得到的所有量，cost 只由它決定 */
+struct PackResult {
+    std::int64_t area;         // 整體外框面積
+    std::int64_t penalty_area; // 所有 island 的空白面積
+    std::int64_t wirelength;   // 所有 block 中心兩兩的 Manhattan 距離總和
+};
 
 /* 只處理「島視為矩形 + 其餘模組矩形」的簡化 HB-tree */
 class HbTree {
 public:
-    void Initialize(std::vector<Block> &blocks,
-                    std::vector<SymmGroup> &groups);
+    /* 整棵 HB-tree 與所有 block 座標的快照，還原時不需要重新 pack */
+    struct Snapshot {
+        NodeArenaType arena;
+        TreeType::State tree;
+        NodeIndex root;
+        std::vector<AsfIsland::Snapshot> islands;
+        Placement placement;
+    };
+
+    void Initialize(const BlockTable &table,
+                    Placement &placement,
+                    const std::vector<SymmGroup> &groups);
 
-    void UpdateNodes(const std::vector<Block> &blocks);
+    void UpdateNodes(const Placement &placement);
 
     void BuildInitialSolution();
 
-    std::int64_t PackAndGetArea(std::vector<Block> &blocks,
-                                double penalty_factor=0.);
+    PackResult Pack(Placement &placement);
+
+    void SaveSnapshot(const Placement &placement, Snapshot &snap) const;
+    void RestoreSnapshot(Placement &placement, const Snapshot &snap);
 
     int GetNumberNodes() const;
-    AsfIsland * GetIsland(int idx);
+    const AsfIsland * GetIsland(int idx) const;
+
+    void RotateNode(Placement &placement, const int idx);
+    SwapNodeOp SwapNodeRandomize(PRNG &rng);
+    LeafMoveOp MoveLeafNodeRandomize(PRNG &rng);
 
-    void RotateNode(std::vector<Block> &blocks, const int idx);
-    SwapNodeOp SwapNodeRandomize();
-    LeafMoveOp MoveLeafNodeRandomize();
+    // 擾動第 idx 個對稱群內部的樹，節點都在同一個 arena_ 裡
+    RotateNodeOp RotateIslandNodeRandomize(PRNG &rng, Placement &placement, int idx);
+    SwapNodeOp SwapIslandNodeRandomize(PRNG &rng, int idx);
+    LeafMoveOp MoveIslandLeafNodeRandomize(PRNG &rng, int idx);
 
 private:
-    NodePointer GetNode(int idx);
+    NodeIndex GetNode(int idx) const;
     bool IsSoloNode(const int idx) const;
 
-    NodePointerList solo_nodes_;                      // 單個 block 代表的節點
-    NodePointerList hier_nodes_;                      // 對稱群代表的節點
-    NodePointerList all_nodes_;
-    std::vector<std::unique_ptr<AsfIsland>> islands_; // 所有對稱群
-    BStarTree<IdType> bs_tree_;
+    NodeArenaType arena_;                             // HB-tree 與所有 island 的節點
+    NodeIndexList solo_nodes_;                        // 單個 block 代表的節點
+    NodeIndexList hier_nodes_;                        // 對稱群代表的節點
+    NodeIndexList all_nodes_;
+    std::vector<AsfIsland> islands_;                  // 所有對稱群
+    TreeType bs_tree_;
+    WirelengthEvaluator wirelength_;
 };
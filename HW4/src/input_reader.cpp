@@ -0,0 +1,372 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "input_reader.hpp"
+
+namespace {
+
+/* 唯讀映射整個檔案，解析時直接在映射的記憶體上切 token，不必複製 */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error("input open failed: " + path);
+        }
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            close(fd_);
+            throw std::runtime_error("input stat failed: " + path);
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (data_ == MAP_FAILED) {
+                close(fd_);
+                throw std::runtime_error("input mmap failed: " + path);
+            }
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+    }
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(data_, size_);
+        }
+        close(fd_);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::string_view View() const {
+        return {static_cast<const char *>(data_), size_};
+    }
+
+private:
+    int fd_{-1};
+    void *data_{nullptr};
+    size_t size_{0};
+};
+
+/* 以空白切開的 token，記錄目前的行列，錯誤訊息指向出錯的 token */
+class Tokenizer {
+public:
+    Tokenizer(std::string_view text, const std::string &name)
+        : text_(text), name_(name) {}
+
+    // 跳過空白，沒有下一個 token 時回傳 true
+    bool AtEnd() {
+        SkipSpace();
+        return pos_ >= text_.size();
+    }
+
+    std::string_view Next(const char *what) {
+        if (AtEnd()) {
+            tok_line_ = line_;
+            tok_col_ = pos_ - line_start_ + 1;
+            Fail(std::string("expected ") + what + " but reached end of file");
+        }
+        tok_line_ = line_;
+        tok_col_ = pos_ - line_start_ + 1;
+        const size_t start = pos_;
+        while (pos_ < text_.size() && !IsSpace(text_[pos_])) {
+            ++pos_;
+        }
+        return text_.substr(start, pos_ - start);
+    }
+
+    void Expect(const char *keyword) {
+        const std::string_view tok = Next(keyword);
+        if (tok != keyword) {
+            Fail(std::string("expected '") + keyword + "' but got '" + std::string(tok) + "'");
+        }
+    }
+
+    // [lo, hi] 之間的十進位整數，lo 是負的時候才接受負號
+    std::int64_t NextInt(const char *what, std::int64_t lo, std::int64_t hi) {
+        const std::string_view tok = Next(what);
+        const bool negative = lo < 0 && !tok.empty() && tok[0] == '-';
+        const std::string_view digits = tok.substr(negative ? 1 : 0);
+        std::int64_t val = 0;
+        bool ok = !digits.empty() && digits.size() <= 18;
+        for (const char c: digits) {
+            if (c < '0' || c > '9') {
+                ok = false;
+                break;
+            }
+            val = val * 10 + (c - '0');
+        }
+        if (negative) {
+            val = -val;
+        }
+        if (!ok) {
+            Fail(std::string("expected ") + what + " but got '" + std::string(tok) + "'");
+        }
+        if (val < lo || val > hi) {
+            Fail(std::string(what) + " " + std::string(tok) + " is out of range [" +
+                     std::to_string(lo) + ", " + std::to_string(hi) + "]");
+        }
+        return val;
+    }
+
+    // 錯誤的位置是最後一個讀到的 token
+    [[noreturn]] void Fail(const std::string &message) const {
+        throw ParseError(name_ + ":" + std::to_string(tok_line_) + ":" +
+                             std::to_string(tok_col_) + ": " + message);
+    }
+
+private:
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    void SkipSpace() {
+        while (pos_ < text_.size() && IsSpace(text_[pos_])) {
+            if (text_[pos_] == '\n') {
+                ++line_;
+                line_start_ = pos_ + 1;
+            }
+            ++pos_;
+        }
+    }
+
+    std::string_view text_;
+    const std::string &name_;
+    size_t pos_{0};
+    size_t line_{1};
+    size_t line_start_{0};
+    size_t tok_line_{1};
+    size_t tok_col_{1};
+};
+
+/*
+ * block 名稱 -> id 的 open addressing 雜湊表。名稱直接指向輸入的內容，
+ * 只在解析期間使用，不必為每個名稱配置字串。每個位置只存 hash 的高位元
+ * 與 id，比對名稱前先比 hash，表本身小到可以放進 cache。
+ */
+class NameTable {
+public:
+    explicit NameTable(int capacity) {
+        // 負載因子不超過 3/4
+        size_t size = 16;
+        shift_ = 64 - 4;
+        while (4 * (size_t)capacity > 3 * size) {
+            size *= 2;
+            shift_ -= 1;
+        }
+        slots_.assign(size, {0, -1});
+        names_.reserve(capacity);
+        mask_ = size - 1;
+    }
+
+    // 名稱已經存在時回傳 false，id 必須依序給
+    bool Insert(std::string_view name) {
+        const std::uint64_t h = Hash(name);
+        Slot &slot = slots_[Find(name, h)];
+        if (slot.id >= 0) {
+            return false;
+        }
+        slot = {(std::uint32_t)h, (int)names_.size()};
+        names_.emplace_back(name);
+        return true;
+    }
+
+    // 找不到時回傳 -1
+    int Lookup(std::string_view name) const {
+        return slots_[Find(name, Hash(name))].id;
+    }
+
+private:
+    struct Slot {
+        std::uint32_t tag;
+        int id;
+    };
+
+    // FNV-1a
+    static std::uint64_t Hash(std::string_view name) {
+        std::uint64_t h = 14695981039346656037ULL;
+        for (const char c: name) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // name 所在的位置，不存在時是它應該插入的空位。FNV 乘法的低位元只受
+    // 輸入的低位元影響，名稱只差最後幾個字元時會擠在一起，所以位置取高位元
+    size_t Find(std::string_view name, std::uint64_t h) const {
+        const std::uint32_t tag = h;
+        size_t i = h >> shift_;
+        while (slots_[i].id >= 0 &&
+                   (slots_[i].tag != tag || names_[slots_[i].id] != name)) {
+            i = (i + 1) & mask_;
+        }
+        return i;
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<std::string_view> names_; // 依照 id 排列
+    size_t mask_;
+    int shift_;
+};
+
+constexpr int kMaxCount = std::numeric_limits<int>::max() / 2;
+constexpr int kMaxSize = std::numeric_limits<int>::max() / 4;
+constexpr int kMaxCoord = std::numeric_limits<int>::max() / 2;
+constexpr std::int64_t kMaxArea = std::numeric_limits<std::int64_t>::max() / 2;
+
+} // namespace
+
+ProblemInput ParseProblem(std::string_view text, const std::string &name) {
+    Tokenizer tok(text, name);
+    ProblemInput input;
+    BlockTable &table = input.table;
+    Placement &placement = input.placement;
+
+    /* HardBlock 部份 */
+    tok.Expect("NumHardBlocks");
+    const int n = tok.NextInt("block count", 1, kMaxCount);
+    table.names.reserve(n);
+    table.gids.reserve(n);
+    table.pre_rotated.reserve(n);
+    placement.Reserve(n);
+    NameTable ids(n);
+
+    for (int i = 0; i < n; ++i) {
+        tok.Expect("HardBlock");
+        const std::string_view block = tok.Next("block name");
+        if (!ids.Insert(block)) {
+            tok.Fail("duplicate block name '" + std::string(block) + "'");
+        }
+        const int w = tok.NextInt("block width", 1, kMaxSize);
+        const int h = tok.NextInt("block height", 1, kMaxSize);
+        table.names.emplace_back(block);
+        table.gids.emplace_back(-1);
+        table.pre_rotated.emplace_back(false);
+        placement.Add(w, h);
+    }
+
+    /* SymGroup 部份，沒有這一段時表示沒有對稱群 */
+    if (tok.AtEnd()) {
+        return input;
+    }
+    tok.Expect("NumSymGroups");
+    const int m = tok.NextInt("symmetry group count", 0, n);
+    input.groups.resize(m);
+
+    // 讀入一個 block 名稱並登記到第 gid 個對稱群
+    auto ReadMember = [&](int gid) {
+        const std::string_view block = tok.Next("block name");
+        const int id = ids.Lookup(block);
+        if (id < 0) {
+            tok.Fail("unknown block '" + std::string(block) + "'");
+        }
+        if (table.gids[id] != -1) {
+            tok.Fail("block '" + std::string(block) + "' is already in symmetry group '" +
+                         input.groups[table.gids[id]].name + "'");
+        }
+        table.gids[id] = gid;
+        return id;
+    };
+
+    for (int i = 0; i < m; ++i) {
+        SymmGroup &group = input.groups[i];
+        tok.Expect("SymGroup");
+        group.name = tok.Next("symmetry group name");
+        // 空的對稱群沒有代表節點，無法建立 ASF island
+        const int cnt = tok.NextInt("symmetry group size", 1, n);
+        group.axis = Axis::kVertical;
+        group.gid = i;
+
+        for (int j = 0; j < cnt; ++j) {
+            const std::string_view kind = tok.Next("'SymPair' or 'SymSelf'");
+            if (kind == "SymPair") {
+                SymmPair symm_pair;
+                symm_pair.aid = ReadMember(i);
+                symm_pair.bid = ReadMember(i);
+                symm_pair.a = table.names[symm_pair.aid];
+                symm_pair.b = table.names[symm_pair.bid];
+                // 兩個 block 必須等寬才能鏡射，必要時先旋轉其中一個
+                if (placement.GetRotatedWidth(symm_pair.aid) !=
+                        placement.GetRotatedWidth(symm_pair.bid)) {
+                    placement.PreRotate(symm_pair.aid);
+                    table.pre_rotated[symm_pair.aid] = !table.pre_rotated[symm_pair.aid];
+                }
+                if (placement.GetRotatedWidth(symm_pair.aid) !=
+                            placement.GetRotatedWidth(symm_pair.bid) ||
+                        placement.GetRotatedHeight(symm_pair.aid) !=
+                            placement.GetRotatedHeight(symm_pair.bid)) {
+                    tok.Fail("blocks '" + symm_pair.a + "' and '" + symm_pair.b +
+                                 "' of a symmetry pair have different sizes");
+                }
+                group.pairs.emplace_back(symm_pair);
+            } else if (kind == "SymSelf") {
+                SymmSelf symm_self;
+                symm_self.id = ReadMember(i);
+                symm_self.a = table.names[symm_self.id];
+                group.selfs.emplace_back(symm_self);
+            } else {
+                tok.Fail("expected 'SymPair' or 'SymSelf' but got '" + std::string(kind) + "'");
+            }
+        }
+    }
+    if (!tok.AtEnd()) {
+        tok.Next("end of file");
+        tok.Fail("unexpected token after the last symmetry group");
+    }
+    return input;
+}
+
+ProblemInput ReadProblem(const std::string &path) {
+    MappedFile file(path);
+    return ParseProblem(file.View(), path);
+}
+
+std::int64_t ParseSolution(std::string_view text, const std::string &name,
+                           const BlockTable &table, Placement &placement) {
+    Tokenizer tok(text, name);
+    const int n = table.Size();
+    NameTable ids(n);
+    for (const auto &block: table.names) {
+        ids.Insert(block);
+    }
+
+    tok.Expect("Area");
+    const std::int64_t area = tok.NextInt("area", 0, kMaxArea);
+    tok.Expect("NumHardBlocks");
+    tok.NextInt("block count", n, n);
+
+    // 負的座標照樣讀入，由 VerifyPlacement 回報
+    std::vector<bool> seen(n, false);
+    for (int i = 0; i < n; ++i) {
+        const std::string_view block = tok.Next("block name");
+        const int id = ids.Lookup(block);
+        if (id < 0) {
+            tok.Fail("unknown block '" + std::string(block) + "'");
+        }
+        if (seen[id]) {
+            tok.Fail("duplicate block '" + std::string(block) + "'");
+        }
+        seen[id] = true;
+        placement.x[id] = tok.NextInt("x coordinate", -kMaxCoord, kMaxCoord);
+        placement.y[id] = tok.NextInt("y coordinate", -kMaxCoord, kMaxCoord);
+        const bool rotated = tok.NextInt("rotation flag", 0, 1);
+        // 輸出的旋轉是相對於輸入的寬高，placement 的寬高可能已經預先旋轉過
+        placement.SetRotated(id, rotated != table.pre_rotated[id]);
+    }
+    if (!tok.AtEnd()) {
+        tok.Next("end of file");
+        tok.Fail("unexpected token after the last block");
+    }
+    return area;
+}
+
+std::int64_t ReadSolution(const std::string &path, const BlockTable &table, Placement &placement) {
+    MappedFile file(path);
+    return ParseSolution(file.View(), path, table, placement);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.hpp"
+
+/* 讀檔得到的所有資料，SymPair 為了等寬需要的預先旋轉也已經處理好 */
+struct ProblemInput {
+    BlockTable table;
+    Placement placement;
+    std::vector<SymmGroup> groups;
+};
+
+/* 輸入格式錯誤，訊息的格式為 "檔名:行:列: 說明" */
+class ParseError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// 以 mmap 讀入整個檔案後解析，檔案打不開時丟出 std::runtime_error，
+// 格式錯誤時丟出 ParseError
+ProblemInput ReadProblem(const std::string &path);
+
+// 解析記憶體中的輸入內容，name 只用在錯誤訊息中
+ProblemInput ParseProblem(std::string_view text, const std::string &name);
+
+// 讀入 WriteFile 格式的輸出檔，把座標與旋轉寫到 placement 並回傳檔案中的 Area。
+// placement 必須是 ReadProblem 得到的，所有 block 都要出現剛好一次
+std::int64_t ReadSolution(const std::string &path, const BlockTable &table, Placement &placement);
+std::int64_t ParseSolution(std::string_view text, const std::string &name,
+                           const BlockTable &table, Placement &placement);
@@ -1,16 +1,155 @@
 #include <iostream>
 #include <string>
+#include <vector>
 
+#include "input_reader.hpp"
 #include "placer.hpp"
+#include "verifier.hpp"
+
+static void PrintUsage() {
+    std::cout << "usage: ./hw4 in.txt out.out [options]\n"
+              << "       ./hw4 in.txt out.out --check\n"
+              << "  --check            不跑 SA，只檢查已經存在的 out.out 是否合法，規則與 verifier/verify 相同\n"
+              << "  --time-limit SEC   SA 的時間上限，預設 295 秒\n"
+              << "  --seed N           亂數種子 (不能是 0)，預設為隨機\n"
+              << "  --threads N        同時跑 N 個不同種子的 SA，預設 1\n"
+              << "  --parallel restart|tempering\n"
+              << "                     多執行緒時各自獨立退火，或是 N 個溫度的 replica exchange，預設 restart\n"
+              << "  --batch B          每步以 B 個 thread 同時 pack B 個候選擾動，預設 1 (逐一評估)\n"
+              << "  --cooling R|auto   一輪沒有進步時溫度乘上的比例，預設 0.9\n"
+              << "                     auto 表示依剩餘時間調整，在時間用完前降到最低溫\n"
+              << "  --round-factor K   每輪最多 block 數量 * K 次上坡，預設 50\n"
+              << "  --stop-rounds N    連續 N 輪沒有進步就停止，預設 50\n"
+              << "  --max-steps N      最多模擬 N 步，預設 0 (不限制)\n"
+              << "  --checkpoint-interval SEC\n"
+              << "                     每隔 SEC 秒把目前最好的解寫到輸出檔，預設 30，0 表示不寫\n"
+              << "  --trace FILE       把每輪與每種擾動的統計寫成 CSV\n"
+              << "  --move-select uniform|adaptive\n"
+              << "                     選擇擾動的方式，預設 uniform\n";
+}
+
+/* 解析命令列，格式錯誤時回傳 false */
+static bool ParseArgs(int argc, const char ** argv,
+                      std::vector<std::string> &files, PlacerOptions &options,
+                      bool &check_only) {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                files.emplace_back(arg);
+                continue;
+            }
+            if (arg == "--check") {
+                check_only = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string val = argv[++i];
+            if (arg == "--time-limit") {
+                options.time_limit_sec = std::stod(val);
+            } else if (arg == "--seed") {
+                options.has_seed = true;
+                options.seed = std::stoull(val);
+            } else if (arg == "--threads") {
+                options.num_threads = std::stoi(val);
+            } else if (arg == "--cooling") {
+                if (val == "auto") {
+                    options.auto_cooling = true;
+                } else {
+                    options.auto_cooling = false;
+                    options.cooling = std::stod(val);
+                }
+            } else if (arg == "--round-factor") {
+                options.round_factor = std::stoi(val);
+            } else if (arg == "--stop-rounds") {
+                options.stop_rounds = std::stoi(val);
+            } else if (arg == "--max-steps") {
+                options.max_steps = std::stoll(val);
+            } else if (arg == "--move-select") {
+                if (val == "adaptive") {
+                    options.adaptive_moves = true;
+                } else if (val == "uniform") {
+                    options.adaptive_moves = false;
+                } else {
+                    return false;
+                }
+            } else if (arg == "--parallel") {
+                if (val == "tempering") {
+                    options.tempering = true;
+                } else if (val == "restart") {
+                    options.tempering = false;
+                } else {
+                    return false;
+                }
+            } else if (arg == "--batch") {
+                options.batch_size = std::stoi(val);
+            } else if (arg == "--trace") {
+                options.trace_path = val;
+            } else if (arg == "--checkpoint-interval") {
+                options.checkpoint_interval_sec = std::stod(val);
+            } else {
+                return false;
+            }
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+    return files.size() == 2 &&
+               options.time_limit_sec > 0 &&
+               (!options.has_seed || options.seed != 0) && // xorshift 的狀態不能是 0
+               options.num_threads >= 1 &&
+               options.batch_size >= 1 &&
+               options.cooling > 0 && options.cooling < 1 &&
+               options.round_factor > 0 &&
+               options.stop_rounds > 0 &&
+               options.max_steps >= 0 &&
+               options.checkpoint_interval_sec >= 0;
+}
+
+/* 檢查已經存在的輸出檔，合法時回傳 0 */
+static int CheckSolution(const std::string &input_path, const std::string &output_path) {
+    Timer timer;
+    ProblemInput input = ReadProblem(input_path);
+    const std::int64_t area = ReadSolution(output_path, input.table, input.placement);
+    const VerifyResult result = VerifyPlacement(input.table, input.groups, input.placement, area);
+    if (result.legal) {
+        std::cout << "[Success] Your output file satisfies our basic requirements.\n";
+    } else {
+        PrintErrors(std::cout, result);
+    }
+    std::cerr << "[INFO] area = " << result.area
+                  << ", check time = " << timer.GetDurationMilliseconds() << " ms\n";
+    return result.legal ? 0 : 1;
+}
 
 int main(int argc, const char ** argv){
-    if (argc != 3) {
-        std::cout<<"usage: ./hw4 in.txt out.out\n"; return -1;
+    std::vector<std::string> files;
+    PlacerOptions options;
+    bool check_only = false;
+    if (!ParseArgs(argc, argv, files, options, check_only)) {
+        PrintUsage(); return -1;
+    }
+    if (check_only) {
+        try {
+            return CheckSolution(files[0], files[1]);
+        } catch (const std::exception &e) {
+            std::cerr << "[ERROR] " << e.what() << "\n";
+            return -1;
+        }
+    }
+    options.checkpoint_path = files[1];
+    Placer p(options);
+    try {
+        p.ReadFile(files[0]);
+    } catch (const std::exception &e) {
+        // 輸入格式錯誤時指出檔案中的行列
+        std::cerr << "[ERROR] " << e.what() << "\n";
+        return -1;
     }
-    Placer p;
-    p.ReadFile(std::string(argv[1]));
-    p.RunSimulatedAnnealing();
-    p.WriteFile(std::string(argv[2]));
+    p.RunParallelSimulatedAnnealing();
+    p.WriteFile(files[1]);
 
     return 0;
 }
@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "move_selector.hpp"
+
+MoveSelector::MoveSelector() {
+    prob_.fill(1.0 / kNumMoveTypes);
+}
+
+MoveType MoveSelector::Select(PRNG &rng) const {
+    double r = rng.Rand01();
+    for (int i = 0; i < kNumMoveTypes - 1; ++i) {
+        if (r < prob_[i]) {
+            return static_cast<MoveType>(i);
+        }
+        r -= prob_[i];
+    }
+    return static_cast<MoveType>(kNumMoveTypes - 1);
+}
+
+void MoveSelector::EndRound() {
+    double score[kNumMoveTypes];
+    double score_sum = 0.0;
+    for (int i = 0; i < kNumMoveTypes; ++i) {
+        gain_[i] = kDecay * gain_[i] + round_gain_[i];
+        ns_[i] = kDecay * ns_[i] + round_ns_[i];
+        round_gain_[i] = 0;
+        round_ns_[i] = 0;
+
+        score[i] = ns_[i] > 0.0 ? std::max(0.0, gain_[i]) / ns_[i] : 0.0;
+        score_sum += score[i];
+    }
+    // 都沒有進步時維持原本的機率
+    if (score_sum <= 0.0) {
+        return;
+    }
+    for (int i = 0; i < kNumMoveTypes; ++i) {
+        prob_[i] = kMinProb + (1.0 - kMinProb * kNumMoveTypes) * score[i] / score_sum;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "telemetry.hpp"
+#include "utils.hpp"
+
+/*
+ * 依照每種擾動「每微秒帶來多少 cost 下降」調整選擇機率的 bandit。
+ * 每輪結束時以指數衰減的方式累積各擾動的 cost 下降量與花費的時間，
+ * 機率正比於兩者的比值，並保留 kMinProb 讓每種擾動都還有機會被選到。
+ */
+class MoveSelector {
+public:
+    MoveSelector();
+
+    MoveType Select(PRNG &rng) const;
+
+    inline void RecordGain(MoveType type, std::int64_t gain) {
+        round_gain_[static_cast<int>(type)] += gain;
+    }
+    inline void RecordTime(MoveType type, std::int64_t ns) {
+        round_ns_[static_cast<int>(type)] += ns;
+    }
+
+    // 每輪結束時更新機率
+    void EndRound();
+
+    inline double GetProb(MoveType type) const { return prob_[static_cast<int>(type)]; }
+
+private:
+    static constexpr double kMinProb = 0.05;
+    static constexpr double kDecay = 0.8;
+
+    std::array<double, kNumMoveTypes> prob_;
+    std::array<double, kNumMoveTypes> gain_{};
+    std::array<double, kNumMoveTypes> ns_{};
+    std::array<std::int64_t, kNumMoveTypes> round_gain_{};
+    std::array<std::int64_t, kNumMoveTypes> round_ns_{};
+};
@@ -1,133 +1,356 @@
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <cmath>
 #include <limits>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 
+#include "alloc_counter.hpp"
+#include "input_reader.hpp"
 #include "placer.hpp"
 #include "utils.hpp"
+#include "verifier.hpp"
 
-void Placer::ReadFile(const std::string& path) {
-    std::ifstream fin(path);
-    if (!fin) { 
-        throw std::runtime_error("input open failed");
-    }
-    std::string tok;
-    int N;
-
-    /* HardBlock 部份 */
-    fin >> tok >> N;
-    blocks_.reserve(N);
-
-    for(int i = 0; i < N; ++i) {
-        std::string key, name;
-        int w, h;
-
-        fin >> key >> name >> w >> h;
-        blocks_.emplace_back(name, w, h);
-        blocks_.back().gid = -1;
-        blockname_to_id_map_[name] = i;
-    }
-
-    /* SymGroup 部份 */
-    int M;
-    fin >> tok >> M;
-    if (fin.fail()) {
-        M = 0;
-    }
-    groups_.resize(M);
-
-    for (int i = 0 ; i < M; ++i) {
-        SymmGroup& group = groups_[i];
-        int cnt;
-        fin >> tok >> group.name >> cnt;
-        group.axis = Axis::kVertical;
-        group.gid = i;
-
-        for (int j = 0; j < cnt; ++j) {
-            fin >> tok;
-            if (tok == "SymPair") {
-                SymmPair symm_pair;
-                fin >> symm_pair.a >> symm_pair.b;
-                symm_pair.aid = blockname_to_id_map_.at(symm_pair.a);
-                symm_pair.bid = blockname_to_id_map_.at(symm_pair.b);
-                blocks_[symm_pair.aid].gid = i;
-                blocks_[symm_pair.bid].gid = i;
-                group.pairs.emplace_back(symm_pair);
-                if (blocks_[symm_pair.aid].GetRotatedWidth() !=
-                        blocks_[symm_pair.bid].GetRotatedWidth()) {
-                    blocks_[symm_pair.aid].PreRotate();
-                }
-            } else if (tok == "SymSelf") {
-                SymmSelf symm_self;
-                fin >> symm_self.a;
-                symm_self.id = blockname_to_id_map_.at(symm_self.a);
-                blocks_[symm_self.id].gid = i;
-                group.selfs.emplace_back(symm_self);
+namespace {
+
+// --cooling auto 的排程參數：溫度在時間用完前降到 kFrozenTemperature，
+// 保留 kDeadlineMargin 的時間，並保證剩下的時間至少還能跑 kMinRounds 輪
+constexpr double kFrozenTemperature = 1.0;
+constexpr double kDeadlineMargin = 0.02;
+constexpr std::int64_t kMinRounds = 20;
+
+// replica exchange 的參數：溫度梯子從 SA 的初始溫度等比下降到它的
+// kTemperingMinRatio 倍，每個 replica 每段跑 block 數量 * kExchangeSweeps 步
+// (限制在 kMinExchangeSteps 與 kMaxExchangeSteps 之間) 後嘗試交換一次。
+// 連續 kStallExchanges 次交換都沒有找到更小的面積時，所有 replica 一起
+// 進入下一個 beta stage
+constexpr double kTemperingMinRatio = 1e-3;
+constexpr int kExchangeSweeps = 1;
+constexpr int kMinExchangeSteps = 128;
+constexpr int kMaxExchangeSteps = 8192;
+constexpr int kStallExchanges = 200;
+
+/*
+ * 讀時鐘比一次擾動還貴，所以每隔一段步數才檢查一次。block 很多時一步就要
+ * 好幾毫秒，間隔會依照量到的時間縮短，讓兩次檢查相隔約 kTargetMs
+ */
+class TimeCheckInterval {
+public:
+    // 每一步呼叫一次，需要讀時鐘時回傳 true
+    bool Tick() {
+        return --countdown_ == 0;
+    }
+
+    // 讀到時鐘後呼叫，依照與上次檢查相隔的時間調整間隔
+    void Update(std::int64_t elapsed_ms) {
+        if (elapsed_ms - last_check_ms_ > kTargetMs) {
+            interval_ = std::max(1, interval_ / 2);
+        } else if (interval_ < kMaxInterval) {
+            interval_ *= 2;
+        }
+        countdown_ = interval_;
+        last_check_ms_ = elapsed_ms;
+    }
+
+private:
+    static constexpr int kMaxInterval = 256;
+    static constexpr std::int64_t kTargetMs = 10;
+
+    // 從每一步都檢查開始，一開始就很慢時不會先跑完一整段才第一次讀時鐘
+    int interval_{1};
+    int countdown_{1};
+    std::int64_t last_check_ms_{0};
+};
+
+/* 所有 thread 都到達後由最後到達的 thread 執行 completion，之後一起繼續 */
+class Barrier {
+public:
+    explicit Barrier(int count) : count_(count) {}
+
+    template <typename Completion>
+    void ArriveAndWait(Completion &&completion) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        const std::int64_t generation = generation_;
+        if (++arrived_ == count_) {
+            completion();
+            arrived_ = 0;
+            generation_ += 1;
+            cv_.notify_all();
+        } else {
+            cv_.wait(lock, [&]() { return generation_ != generation; });
+        }
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    int count_;
+    int arrived_{0};
+    std::int64_t generation_{0};
+};
+
+/*
+ * 每次 Run() 讓 num_threads 個 thread 各執行一次 job(t)，呼叫的 thread 執行
+ * job(0)，全部做完才回傳。每次的工作只有一次 pack，condition variable 的喚醒
+ * 比工作本身還慢，所以 thread 之間以 atomic 自旋等待，等太久才讓出 CPU
+ */
+class SpinPool {
+public:
+    SpinPool(int num_threads, std::function<void(int)> job) : job_(std::move(job)) {
+        for (int t = 1; t < num_threads; ++t) {
+            threads_.emplace_back([this, t]() { WorkerLoop(t); });
+        }
+    }
+    ~SpinPool() {
+        quit_.store(true);
+        generation_.fetch_add(1, std::memory_order_release);
+        for (auto &t: threads_) {
+            t.join();
+        }
+    }
+    SpinPool(const SpinPool &) = delete;
+    SpinPool &operator=(const SpinPool &) = delete;
+
+    void Run() {
+        pending_.store(threads_.size(), std::memory_order_relaxed);
+        generation_.fetch_add(1, std::memory_order_release);
+        job_(0);
+        SpinUntil([this]() { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    template <typename Pred>
+    static void SpinUntil(Pred pred) {
+        constexpr int kSpins = 1 << 12;
+        for (int i = 0; !pred(); ++i) {
+            if (i >= kSpins) {
+                std::this_thread::yield();
             }
         }
     }
 
-    hb_tree_.Initialize(blocks_, groups_);
-    best_blocks_ = blocks_;
+    void WorkerLoop(int t) {
+        std::int64_t seen = 0;
+        while (true) {
+            SpinUntil([&]() { return generation_.load(std::memory_order_acquire) != seen; });
+            seen += 1; // Run() 等所有 thread 做完才會再加一，不會漏掉任何一次
+            if (quit_.load()) {
+                return;
+            }
+            job_(t);
+            pending_.fetch_sub(1, std::memory_order_release);
+        }
+    }
 
-    beta_reduction_stage_ = 0;
-    ComputeBaseFactor(best_blocks_);
-    best_area_ = ComputeArea(best_blocks_);
-    best_cost_ = ComputeCost(best_blocks_);
+    std::function<void(int)> job_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::int64_t> generation_{0};
+    std::atomic<int> pending_{0};
+    std::atomic<bool> quit_{false};
+};
+
+} // namespace
 
-    // 為 public3 設定的種子
-    if (blocks_.size() == 110) {
-        SetCurrentSeed(4254943934);
+/* replica exchange 時所有 replica 共用的狀態，只在 barrier 的 completion 中修改 */
+struct TemperingContext {
+    explicit TemperingContext(int num_replicas, std::uint64_t seed)
+        : barrier(num_replicas), rng(seed),
+          attempts(num_replicas, 0), accepts(num_replicas, 0) {}
+
+    Barrier barrier;
+    PRNG rng;                          // 決定是否交換
+    Timer timer;
+    int phase_steps{0};                // 每段每個 replica 的擾動數
+    std::vector<int> ladder;           // ladder[k] 是第 k 熱的溫度上的 replica
+    std::vector<std::int64_t> attempts, accepts; // 第 k 與 k+1 個溫度之間的交換
+    int num_exchanges{0};
+    int stall_exchanges{0};
+    int beta_stage{0};
+    std::int64_t next_checkpoint_ms{0};
+    bool stop{false};
+    Placer *coordinator{nullptr};      // 收集最佳解並寫 checkpoint
+    std::vector<Placer> *replicas{nullptr};
+};
+
+/*
+ * 批次評估時的一個候選擾動與它使用的狀態。lane 0 指向 Placer 本身的狀態，
+ * 其他 lane 指向 BatchContext 裡的複本，每一步開始時所有 lane 的快照都相同
+ */
+struct BatchLane {
+    HbTree *hb_tree;
+    Placement *placement;
+    HbTree::Snapshot *snapshot;
+
+    MoveType type;
+    std::uint64_t seed;                // 產生擾動的亂數種子
+    bool applied{false};               // 目前的狀態上還套用著這一步的候選擾動
+    PackResult result;
+    std::int64_t pack_ns{0};
+    std::int64_t move_ns{0};           // 產生擾動加上 pack 的時間，adaptive_moves 時才量
+};
+
+struct BatchContext {
+    explicit BatchContext(int num_lanes)
+        : lanes(num_lanes), trees(num_lanes), placements(num_lanes), snapshots(num_lanes) {}
+
+    std::vector<BatchLane> lanes;
+    std::vector<HbTree> trees;         // lane 1 以後的狀態，第 0 個不使用
+    std::vector<Placement> placements;
+    std::vector<HbTree::Snapshot> snapshots;
+
+    int winner{-1};                    // 上一步接受的 lane，-1 表示都被拒絕
+    MoveType winner_type;
+    std::uint64_t winner_seed;
+    bool generate{true};               // false 時只跟上一步接受的擾動同步
+    bool timing{false};                // 量測 pack 時間
+    bool move_timing{false};           // 量測整個擾動的時間
+    std::unique_ptr<SpinPool> pool;
+};
+
+void SharedSolution::Reset(std::int64_t area, const HbTree &hb_tree, const Placement &placement) {
+    for (auto &slot: slots_) {
+        slot = {area, hb_tree, placement};
     }
-    std::cerr << "[INFO] number blocks = " << blocks_.size() << "\n";
-    std::cerr << "[INFO] seed = " << GetCurrentSeed() << "\n";
+    current_.store(0);
+    best_area_.store(area);
 }
 
-void Placer::WriteFile(const std::string& path) {
-    std::ofstream fout(path);
+bool SharedSolution::TryPublish(std::int64_t area, const HbTree &hb_tree, const Placement &placement) {
+    if (writing_.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+    bool published = false;
+    if (area < best_area_.load()) {
+        // 讀取者登記後會再確認 current_ 沒有改變，所以不是 current_ 的 slot
+        // 只要此時沒有人登記，之後登記的讀取者都會放棄它
+        const int current = current_.load();
+        for (int s = 0; s < kNumSlots; ++s) {
+            if (s == current || readers_[s].load() != 0) {
+                continue;
+            }
+            slots_[s].area = area;
+            slots_[s].hb_tree = hb_tree;
+            slots_[s].placement = placement;
+            current_.store(s);
+            best_area_.store(area);
+            published = true;
+            break;
+        }
+    }
+    writing_.store(false, std::memory_order_release);
+    return published;
+}
 
-    fout << "Area " << best_area_ << "\n\n";
-    fout << "NumHardBlocks " << best_blocks_.size() << "\n";
-    for (auto& b: best_blocks_) {
-        bool rotated = b.rotated ^ b.pre_rotated;
-        fout << b.name << " " << b.x << " " << b.y << " " << (rotated ? 1 : 0) << "\n";
+std::int64_t SharedSolution::Read(HbTree *hb_tree, Placement &placement) const {
+    while (true) {
+        const int s = current_.load();
+        readers_[s].fetch_add(1);
+        if (current_.load() == s) {
+            const Slot &slot = slots_[s];
+            if (hb_tree) {
+                *hb_tree = slot.hb_tree;
+            }
+            placement = slot.placement;
+            const std::int64_t area = slot.area;
+            readers_[s].fetch_sub(1);
+            return area;
+        }
+        // 登記前 current_ 已經換到別的 slot，這個 slot 可能正在被寫入
+        readers_[s].fetch_sub(1);
     }
-    std::cerr << "[INFO] final area = " << best_area_ << "\n";
 }
 
-std::int64_t Placer::ComputeArea(std::vector<Block>& blocks) {
-    return hb_tree_.PackAndGetArea(blocks);
+Placer::Placer(const PlacerOptions &options)
+    : rng_(options.has_seed ? options.seed : PRNG::RandomSeed()),
+      options_(options) {}
+
+void Placer::ReadFile(const std::string& path) {
+    Timer timer;
+    ProblemInput input = ReadProblem(path);
+    table_ = std::move(input.table);
+    placement_ = std::move(input.placement);
+    groups_ = std::move(input.groups);
+    const int read_ms = timer.GetDurationMilliseconds();
+
+    hb_tree_.Initialize(table_, placement_, groups_);
+    best_placement_ = placement_;
+
+    beta_reduction_stage_ = 0;
+    PackResult result = hb_tree_.Pack(best_placement_);
+    ComputeBaseFactor(result);
+    best_area_ = result.area;
+    best_cost_ = ComputeCost(result);
+
+    // 沒有指定種子時，為 public3 設定的種子
+    if (!options_.has_seed && table_.Size() == 110) {
+        rng_.SetSeed(4254943934);
+    }
+    std::cerr << "[INFO] number blocks = " << table_.Size() << "\n";
+    std::cerr << "[INFO] read time = " << read_ms << " ms, initialize time = "
+                  << timer.GetDurationMilliseconds() - read_ms << " ms\n";
+    std::cerr << "[INFO] seed = " << rng_.GetSeed() << "\n";
 }
 
-std::int64_t Placer::ComputeTotalWirelength(const std::vector<Block>& blocks) {
-    auto ManhattanDistance = [](const Block& a, const Block& b) -> double {
-        double ax = a.x + a.GetRotatedWidth() / 2;
-        double ay = a.y + a.GetRotatedHeight() / 2;
-        double bx = b.x + b.GetRotatedWidth() / 2;
-        double by = b.y + b.GetRotatedHeight() / 2;
-        return std::abs(ax - bx) + std::abs(ay - by);
-    };
+void Placer::WriteFile(const std::string& path) {
+    // 寫檔前在程式內檢查一次。不合法時仍然寫出，但印出原因
+    Timer timer;
+    const VerifyResult check = VerifyPlacement(table_, groups_, best_placement_, best_area_);
+    if (check.legal) {
+        std::cerr << "[INFO] self-check passed in " << timer.GetDurationMilliseconds() << " ms\n";
+    } else {
+        PrintErrors(std::cerr, check);
+    }
+    WritePlacement(path, best_area_, best_placement_);
+    std::cerr << "[INFO] final area = " << best_area_ << "\n";
+}
 
-    double total_wirelength = 0.0;
-    const int bsize = blocks.size();
+void Placer::WritePlacement(const std::string& path,
+                            std::int64_t area,
+                            const Placement& placement) const {
+    std::ofstream fout(path);
 
-    for (int i = 0; i < bsize; ++i) {
-        for (int j = i + 1; j < bsize; ++j) {
-            total_wirelength +=
-                ManhattanDistance(blocks[i], blocks[j]);
-        }
+    fout << "Area " << area << "\n\n";
+    fout << "NumHardBlocks " << table_.Size() << "\n";
+    for (int i = 0; i < table_.Size(); ++i) {
+        bool rotated = placement.IsRotated(i) ^ table_.pre_rotated[i];
+        fout << table_.names[i] << " "
+                 << placement.x[i] << " "
+                 << placement.y[i] << " "
+                 << (rotated ? 1 : 0) << "\n";
     }
-    return std::round<std::int64_t>(total_wirelength);
 }
 
-void Placer::ComputeBaseFactor(std::vector<Block>& blocks) {
-    base_area_ = hb_tree_.PackAndGetArea(blocks, 1.0);
-    base_hpwl_ = ComputeTotalWirelength(blocks);
+void Placer::WriteCheckpoint() {
+    if (options_.checkpoint_path.empty()) {
+        return;
+    }
+    // 先寫到暫存檔再改名，程式在寫檔途中被中止也不會留下不完整的輸出
+    const std::string tmp_path = options_.checkpoint_path + ".tmp";
+    if (shared_) {
+        // 先複製出來再寫檔，寫檔期間不佔用 slot
+        Placement placement;
+        const std::int64_t area = shared_->Read(nullptr, placement);
+        WritePlacement(tmp_path, area, placement);
+    } else {
+        WritePlacement(tmp_path, best_area_, best_placement_);
+    }
+    std::rename(tmp_path.c_str(), options_.checkpoint_path.c_str());
+}
+
+void Placer::ComputeBaseFactor(const PackResult& result) {
+    base_area_ = result.area + result.penalty_area;
+    base_hpwl_ = result.wirelength;
 }
 
-std::int64_t Placer::ComputeCost(std::vector<Block>& blocks) {
+std::int64_t Placer::ComputeCost(const PackResult& result) const {
     double alpha = 1.0;
     double beta = 1.0;
     if (beta_reduction_stage_ == 0) {
@@ -141,9 +364,13 @@ std::int64_t Placer::ComputeCost(std::vector<Block>& blocks) {
     } else if (beta_reduction_stage_ == 4) {
         beta = 0.0;
     }
-    double norm_factor = (double)base_area_/base_hpwl_;
-    const double cost = alpha * hb_tree_.PackAndGetArea(blocks, std::max(0.5, beta/2.0)) +
-        beta * norm_factor * ComputeTotalWirelength(blocks);
+    // 所有 block 的中心重合時 (例如只有一個 block) 線長為 0，不計入 cost
+    double norm_factor = base_hpwl_ > 0 ? (double)base_area_/base_hpwl_ : 0.0;
+    const double penalty_factor = std::max(0.5, beta/2.0);
+    const std::int64_t penalty_area =
+        std::round<std::int64_t>(penalty_factor * result.penalty_area);
+    const double cost = alpha * (result.area + penalty_area) +
+        beta * norm_factor * result.wirelength;
     return std::round<std::int64_t>(cost);
 }
 
@@ -161,177 +388,282 @@ bool Placer::TryAcceptSimulation(double delta_cost) {
         accept = true;  // 面積下降，直接接受
     } else if (temperature_ > 0) {
         double prob = std::exp(-1.0 * delta_cost / temperature_);
-        accept = Rand01() < prob;
+        accept = rng_.Rand01() < prob;
     }
     return accept;
 }
 
-void Placer::RotateNode() {
-    int num_nodes = hb_tree_.GetNumberNodes();
-    if (num_nodes < 2) {
-        return;
+void Placer::EvaluateMove(MoveType type) {
+    // 開啟 trace 時才量測 pack 時間，避免每步都讀時鐘
+    std::int64_t pack_ns = 0;
+    PackResult result;
+    if (telemetry_.Timing()) {
+        Timer pack_timer;
+        result = hb_tree_.Pack(placement_);
+        pack_ns = pack_timer.GetDurationNanoseconds();
+    } else {
+        result = hb_tree_.Pack(placement_);
     }
+    if (DecideMove(type, result, pack_ns, hb_tree_, placement_)) {
+        hb_tree_.SaveSnapshot(placement_, snapshot_);
+    } else {
+        hb_tree_.RestoreSnapshot(placement_, snapshot_);
+    }
+}
 
-    int rot_id = RandInt(0, num_nodes - 1);
-    hb_tree_.RotateNode(blocks_, rot_id);
-
-    std::int64_t new_cost = ComputeCost(blocks_);
+bool Placer::DecideMove(MoveType type,
+                        const PackResult& result,
+                        std::int64_t pack_ns,
+                        const HbTree& hb_tree,
+                        const Placement& placement) {
+    std::int64_t new_cost = ComputeCost(result);
     std::int64_t delta_cost = new_cost - curr_cost_;
 
-
-    if (TryAcceptSimulation(delta_cost)) {
+    const bool accepted = TryAcceptSimulation(delta_cost);
+    if (accepted) {
         curr_cost_ = new_cost;
         if (new_cost < best_cost_) {
             best_cost_ = new_cost;
             found_bestcost_ = true;
         }
 
-        std::int64_t curr_area = ComputeArea(blocks_);
-        if (curr_area < best_area_) {
-            best_area_ = curr_area;
-            best_blocks_ = blocks_;
+        if (result.area < best_area_) {
+            best_area_ = result.area;
+            best_placement_ = placement;
+            PublishBest(hb_tree, placement);
         }
         if (delta_cost > 0) {
             uphill_cnt_++;
         }
     } else {
-        hb_tree_.RotateNode(blocks_, rot_id);
-        hb_tree_.PackAndGetArea(blocks_);
         reject_cnt_++;
     }
+    telemetry_.RecordMove(type, accepted, delta_cost, pack_ns);
+    if (accepted) {
+        move_selector_.RecordGain(type, -delta_cost);
+    }
     num_simulations_++;
     gen_cnt_++;
+    return accepted;
 }
 
-void Placer::SwapNode() {
-    SwapNodeOp op = hb_tree_.SwapNodeRandomize();
-    if (!op.Valid()) {
-        return;
+void Placer::RunMove(MoveType type) {
+    if (ApplyMove(type, hb_tree_, placement_, rng_)) {
+        EvaluateMove(type);
     }
-    std::int64_t new_cost = ComputeCost(blocks_);
-    std::int64_t delta_cost = new_cost - curr_cost_;
+}
 
-    if (TryAcceptSimulation(delta_cost)) {
-        curr_cost_ = new_cost;
-        if (new_cost < best_cost_) {
-            best_cost_ = new_cost;
-            found_bestcost_ = true;
-        }
+bool Placer::ApplyMove(MoveType type, HbTree& hb_tree, Placement& placement, PRNG& rng) const {
+    switch (type) {
+        case MoveType::kRotateNode: return RotateNode(hb_tree, placement, rng);
+        case MoveType::kSwapNode: return SwapNode(hb_tree, rng);
+        case MoveType::kGroupNode: return SwapOrRotateGroupNode(hb_tree, placement, rng);
+        case MoveType::kMoveLeafNode: return MoveLeafNode(hb_tree, rng);
+        default: return false;
+    }
+}
 
-        std::int64_t curr_area = ComputeArea(blocks_);
-        if (curr_area < best_area_) {
-            best_area_ = curr_area;
-            best_blocks_ = blocks_;
-        }
-        if (delta_cost > 0) {
-            uphill_cnt_++;
-        }
-    } else {
-        op.Undo();
-        hb_tree_.PackAndGetArea(blocks_);
-        reject_cnt_++;
+bool Placer::RotateNode(HbTree& hb_tree, Placement& placement, PRNG& rng) const {
+    int num_nodes = hb_tree.GetNumberNodes();
+    if (num_nodes < 2) {
+        return false;
     }
-    num_simulations_++;
-    gen_cnt_++;
+
+    int rot_id = rng.RandInt(0, num_nodes - 1);
+    hb_tree.RotateNode(placement, rot_id);
+    return true;
+}
+
+bool Placer::SwapNode(HbTree& hb_tree, PRNG& rng) const {
+    SwapNodeOp op = hb_tree.SwapNodeRandomize(rng);
+    return op.Valid();
 }
 
-void Placer::SwapOrRotateGroupNode() {
+bool Placer::SwapOrRotateGroupNode(HbTree& hb_tree, Placement& placement, PRNG& rng) const {
 
     if (groups_.empty()) {
-        return;
+        return false;
     }
     RotateNodeOp rot_op;
     SwapNodeOp swap_op;
     LeafMoveOp move_op;
 
 
-    int idx = RandInt(0, (int)groups_.size()-1);
-    int select_op = RandInt(0, 2);
+    int idx = rng.RandInt(0, (int)groups_.size()-1);
+    int select_op = rng.RandInt(0, 2);
 
     if (select_op == 0) {
-        rot_op = hb_tree_.GetIsland(idx)->RotateNodeRandomize(blocks_);
+        rot_op = hb_tree.RotateIslandNodeRandomize(rng, placement, idx);
         if (!rot_op.Valid()) {
-            return;
+            return false;
         }
     } else if (select_op == 1) {
-        swap_op = hb_tree_.GetIsland(idx)->SwapNodeRandomize();
+        swap_op = hb_tree.SwapIslandNodeRandomize(rng, idx);
         if (!swap_op.Valid()) {
-            return;
+            return false;
         }
     } else if (select_op == 2) {
-        move_op = hb_tree_.GetIsland(idx)->MoveLeafNodeRandomize();
+        move_op = hb_tree.MoveIslandLeafNodeRandomize(rng, idx);
         if (!move_op.Valid()) {
-            return;
+            return false;
         }
     }
 
-    std::int64_t new_cost = ComputeCost(blocks_);
-    std::int64_t delta_cost = new_cost - curr_cost_;
+    return true;
+}
 
-    if (TryAcceptSimulation(delta_cost)) {
-        curr_cost_ = new_cost;
-        if (new_cost < best_cost_) {
-            best_cost_ = new_cost;
-            found_bestcost_ = true;
-        }
+bool Placer::MoveLeafNode(HbTree& hb_tree, PRNG& rng) const {
+    LeafMoveOp op = hb_tree.MoveLeafNodeRandomize(rng);
+    return op.Valid();
+}
 
-        std::int64_t curr_area = ComputeArea(blocks_);
-        if (curr_area < best_area_) {
-            best_area_ = curr_area;
-            best_blocks_ = blocks_;
-        }
-        if (delta_cost > 0) {
-            uphill_cnt_++;
-        }
-    } else {
-        if (select_op == 0) {
-            rot_op.Undo();
-        } else if (select_op == 1) {
-            swap_op.Undo();
-        } else if (select_op == 2) {
-            move_op.Undo();
-        }
-        hb_tree_.PackAndGetArea(blocks_);
-        reject_cnt_++;
+void Placer::PublishBest(const HbTree& hb_tree, const Placement& placement) {
+    // 其他 worker 正在寫入時放棄這次發佈，之後找到更好的解時會再發佈，
+    // 結束時也會從每個 worker 收集最佳解
+    if (shared_ && best_area_ < shared_->GetBestArea()) {
+        shared_->TryPublish(best_area_, hb_tree, placement);
     }
-    num_simulations_++;
-    gen_cnt_++;
 }
 
-void Placer::MoveLeafNode() {
-    LeafMoveOp op = hb_tree_.MoveLeafNodeRandomize();
-    if (!op.Valid()) {
-        return;
+bool Placer::TryAdoptSharedBest() {
+    // 連續多輪沒有進步，而且其他 worker 找到更好的解時，從該解重新開始
+    constexpr int kStallRounds = 10;
+    if (!shared_ ||
+            not_found_bestcost_accum_ < kStallRounds ||
+            shared_->GetBestArea() >= best_area_) {
+        return false;
     }
+    best_area_ = shared_->Read(&hb_tree_, placement_);
+    best_placement_ = placement_;
+    best_cost_ = ComputeCost(hb_tree_.Pack(placement_));
+    hb_tree_.SaveSnapshot(placement_, snapshot_);
+    not_found_bestcost_accum_ = 0;
+    return true;
+}
 
-    std::int64_t new_cost = ComputeCost(blocks_);
-    std::int64_t delta_cost = new_cost - curr_cost_;
+void Placer::StartBatch(BatchContext &ctx) {
+    SyncBatchLanes(ctx);
+    ctx.timing = telemetry_.Timing();
+    ctx.move_timing = options_.adaptive_moves;
+    ctx.pool = std::make_unique<SpinPool>(ctx.lanes.size(), [this, &ctx](int idx) {
+        RunBatchLane(ctx, idx);
+    });
+}
 
-    if (TryAcceptSimulation(delta_cost)) {
-        curr_cost_ = new_cost;
-        if (new_cost < best_cost_) {
-            best_cost_ = new_cost;
-            found_bestcost_ = true;
+void Placer::SyncBatchLanes(BatchContext &ctx) {
+    // Placer 本身的狀態被整個換掉時 (開始或是改用共享的最佳解)，把它複製到
+    // 每個 lane。此時 Placer 的狀態與它的快照相同，lane 的快照由 SaveSnapshot
+    // 產生而不是直接複製，才會預留足夠的容量，之後不必再配置記憶體
+    for (size_t i = 0; i < ctx.lanes.size(); ++i) {
+        BatchLane &lane = ctx.lanes[i];
+        if (i == 0) {
+            lane.hb_tree = &hb_tree_;
+            lane.placement = &placement_;
+            lane.snapshot = &snapshot_;
+        } else {
+            ctx.trees[i] = hb_tree_;
+            ctx.placements[i] = placement_;
+            lane.hb_tree = &ctx.trees[i];
+            lane.placement = &ctx.placements[i];
+            lane.snapshot = &ctx.snapshots[i];
+            lane.hb_tree->SaveSnapshot(*lane.placement, *lane.snapshot);
         }
+        lane.applied = false;
+    }
+    ctx.winner = -1;
+}
 
-        std::int64_t curr_area = ComputeArea(blocks_);
-        if (curr_area < best_area_) {
-            best_area_ = curr_area;
-            best_blocks_ = blocks_;
+void Placer::RunBatchStep(BatchContext &ctx) {
+    // 擾動的種類與種子都在這裡依序產生，結果只由 rng_ 決定，與 thread 的排程無關
+    for (auto &lane: ctx.lanes) {
+        lane.type = options_.adaptive_moves ?
+                        move_selector_.Select(rng_) :
+                        static_cast<MoveType>(rng_.RandInt(0, kNumMoveTypes - 1));
+        lane.seed = rng_.Rand64();
+    }
+    ctx.generate = true;
+    ctx.pool->Run();
+
+    // 依照順序檢查，第一個通過 Metropolis 準則的候選被接受。在它之前的候選
+    // 都被拒絕，狀態沒有改變，與逐一評估時相同；在它之後的候選是從舊的狀態
+    // 產生的，直接丟掉，也不計入步數
+    ctx.winner = -1;
+    for (int i = 0; i < (int)ctx.lanes.size(); ++i) {
+        const BatchLane &lane = ctx.lanes[i];
+        if (ctx.move_timing) {
+            move_selector_.RecordTime(lane.type, lane.move_ns);
         }
-        if (delta_cost > 0) {
-            uphill_cnt_++;
+        if (!lane.applied) {
+            continue;
         }
+        if (DecideMove(lane.type, lane.result, lane.pack_ns, *lane.hb_tree, *lane.placement)) {
+            ctx.winner = i;
+            ctx.winner_type = lane.type;
+            ctx.winner_seed = lane.seed;
+            break;
+        }
+    }
+}
+
+void Placer::RunBatchLane(BatchContext &ctx, int idx) const {
+    // 在各自的 thread 上執行，只會讀寫第 idx 個 lane
+    BatchLane &lane = ctx.lanes[idx];
+    HbTree &hb_tree = *lane.hb_tree;
+    Placement &placement = *lane.placement;
+    const std::int64_t alloc_count = GetAllocCount();
+
+    // 先跟上一步接受的擾動同步。接受它的 lane 直接存成快照；其他 lane 還原到
+    // 快照後以相同的種子重播同一個擾動，相同的狀態與種子會得到相同的結果
+    if (ctx.winner == idx) {
+        hb_tree.SaveSnapshot(placement, *lane.snapshot);
     } else {
-        op.Undo();
-        hb_tree_.PackAndGetArea(blocks_);
-        reject_cnt_++;
+        if (lane.applied) {
+            hb_tree.RestoreSnapshot(placement, *lane.snapshot);
+        }
+        if (ctx.winner >= 0) {
+            PRNG rng(ctx.winner_seed);
+            ApplyMove(ctx.winner_type, hb_tree, placement, rng);
+            hb_tree.Pack(placement);
+            hb_tree.SaveSnapshot(placement, *lane.snapshot);
+        }
     }
-    num_simulations_++;
-    gen_cnt_++;
+    lane.applied = false;
+
+    // 產生這一步的候選擾動並 pack，結果留在 lane 上等待決定
+    auto Generate = [&]() {
+        PRNG rng(lane.seed);
+        lane.applied = ApplyMove(lane.type, hb_tree, placement, rng);
+        if (!lane.applied) {
+            return;
+        }
+        if (ctx.timing) {
+            Timer pack_timer;
+            lane.result = hb_tree.Pack(placement);
+            lane.pack_ns = pack_timer.GetDurationNanoseconds();
+        } else {
+            lane.result = hb_tree.Pack(placement);
+        }
+    };
+    if (ctx.generate && ctx.move_timing) {
+        Timer move_timer;
+        Generate();
+        lane.move_ns = move_timer.GetDurationNanoseconds();
+    } else if (ctx.generate) {
+        Generate();
+    }
+    assert(GetAllocCount() == alloc_count);
+}
+
+void Placer::FinishBatch(BatchContext &ctx) {
+    // 讓 Placer 本身的狀態回到最後接受的狀態
+    ctx.generate = false;
+    ctx.pool->Run();
+    ctx.winner = -1;
+    ctx.pool.reset();
 }
 
 void Placer::UpdateStats() {
+    round_timeout_ = false;
     num_iterations_ += 1;
     gen_cnt_ = 0;
     uphill_cnt_ = 0;
@@ -339,18 +671,45 @@ void Placer::UpdateStats() {
     found_bestcost_ = false;
 }
 
+void Placer::UpdateSchedule(std::int64_t elapsed_ms) {
+    // 以目前每毫秒的擾動數估計剩下的擾動數，讓溫度在時間用完前剛好降到
+    // kFrozenTemperature，並保證至少還有 kMinRounds 輪。保留 kDeadlineMargin
+    // 的時間，讓 SA 自然結束而不是被時間上限中斷
+    if (elapsed_ms <= 0 || num_iterations_ <= 0 || num_simulations_ <= 0) {
+        return;
+    }
+    const std::int64_t deadline_ms = options_.time_limit_sec * 1000 * (1.0 - kDeadlineMargin);
+    const std::int64_t remaining_ms = std::max<std::int64_t>(deadline_ms - elapsed_ms, 1);
+    const double moves_per_ms = (double)num_simulations_ / elapsed_ms;
+    const double remaining_moves = moves_per_ms * remaining_ms;
+
+    const std::int64_t max_gen_limit = 2LL * table_.Size() * options_.round_factor;
+    round_gen_limit_ = std::clamp<std::int64_t>(
+        remaining_moves / kMinRounds, table_.Size(), max_gen_limit);
+
+    const double moves_per_round = std::min<double>(
+        (double)num_simulations_ / num_iterations_, round_gen_limit_);
+    const double remaining_rounds = std::max(1.0, remaining_moves / moves_per_round);
+    if (temperature_ > kFrozenTemperature) {
+        cooling_ = std::pow(kFrozenTemperature / temperature_, 1.0 / remaining_rounds);
+        cooling_ = std::clamp(cooling_, 0.5, 0.9999);
+    }
+}
+
 bool Placer::ShouldStopRound() const {
-    constexpr int K = 50;
-    const int kStopFactor = blocks_.size() * K;
-    const int kGenerationMin = kStopFactor * 2;
+    const std::int64_t kStopFactor = round_gen_limit_ / 2;
+    const std::int64_t kGenerationMin = round_gen_limit_;
     return stop_ ||
+               round_timeout_ ||
                uphill_cnt_ > kStopFactor ||
                gen_cnt_ > kGenerationMin;
 }
 
 bool Placer::ShouldStopRunning() const {
+    // 自動降溫時由溫度與時間決定何時停止，不因為連續沒有進步而提早結束
     return stop_ ||
-               not_found_bestcost_accum_ >= 50 ||
+               (!options_.auto_cooling &&
+                    not_found_bestcost_accum_ >= options_.stop_rounds) ||
                temperature_ < 1.0;
 }
 
@@ -361,23 +720,62 @@ void Placer::RunSimulatedAnnealing() {
     not_found_bestcost_accum_ = 0;
     Timer timer;
 
+    // 拒絕擾動時直接還原到這個快照，不需要 undo 後重新 pack
+    hb_tree_.Pack(placement_);
+    hb_tree_.SaveSnapshot(placement_, snapshot_);
+
+    std::ofstream trace;
+    if (checkpoint_ && !options_.trace_path.empty()) {
+        trace.open(options_.trace_path);
+        Telemetry::WriteCsvHeader(trace);
+    }
+    telemetry_.SetTiming(trace.is_open());
+
     stop_ = false;
-    int maxtime_sec = (5 * 60) - 5; // 5 秒當緩衝時間
+    cooling_ = options_.cooling;
+    round_gen_limit_ = 2LL * table_.Size() * options_.round_factor;
+    const std::int64_t checkpoint_ms = options_.checkpoint_interval_sec * 1000;
+    std::int64_t next_checkpoint_ms = checkpoint_ms;
+
+    const std::int64_t time_limit_ms = options_.time_limit_sec * 1000;
+    TimeCheckInterval time_check;
+    int next_report = 0;
+
+    std::unique_ptr<BatchContext> batch;
+    if (options_.batch_size > 1) {
+        batch = std::make_unique<BatchContext>(options_.batch_size);
+        StartBatch(*batch);
+    }
 
     do {
         UpdateStats();
+        // 一步很慢時第一輪可能就用掉所有時間，所以每輪的時間也有上限
+        std::int64_t round_end_ms = std::numeric_limits<std::int64_t>::max();
+        if (options_.auto_cooling) {
+            const std::int64_t deadline_ms = time_limit_ms * (1.0 - kDeadlineMargin);
+            const std::int64_t now_ms = timer.GetDurationMilliseconds();
+            round_end_ms = now_ms + std::max<std::int64_t>(1, (deadline_ms - now_ms) / kMinRounds);
+        }
         do {
             curr_cost_ = best_cost_;
-            int move_type = RandInt(0, 3);
-
-            switch (move_type) {
-                case 0: RotateNode(); break;
-                case 1: SwapNode(); break;
-                case 2: SwapOrRotateGroupNode(); break;
-                case 3: MoveLeafNode(); break;
-                default: ;
+            const std::int64_t alloc_count = GetAllocCount();
+            if (batch) {
+                RunBatchStep(*batch);
+            } else if (options_.adaptive_moves) {
+                // 量測整個擾動 (包含產生擾動本身) 的時間
+                const MoveType move_type = move_selector_.Select(rng_);
+                Timer move_timer;
+                RunMove(move_type);
+                move_selector_.RecordTime(move_type, move_timer.GetDurationNanoseconds());
+            } else {
+                RunMove(static_cast<MoveType>(rng_.RandInt(0, kNumMoveTypes - 1)));
             }
-            if (num_simulations_ % 1000 == 0) {
+            // 以 -DPLACER_COUNT_ALLOCS 編譯時，檢查擾動、pack 與接受或還原的
+            // 過程沒有配置記憶體，所有緩衝區在初始化時就已經預留好
+            assert(GetAllocCount() == alloc_count);
+            if (verbose_ && num_simulations_ >= next_report) {
+                // 批次評估時一步可能跨過好幾個整千步
+                next_report = num_simulations_ / 1000 * 1000 + 1000;
                 std::cerr << std::fixed << std::setprecision(4)
                           << "[step: " << std::setw(8) << num_simulations_
                           << " | time: " << std::setw(8) << timer.GetDurationSeconds() << " sec"
@@ -385,14 +783,28 @@ void Placer::RunSimulatedAnnealing() {
                           << " | cost: " << std::setw(10) << best_cost_
                           << "]" << std::endl;
             }
-            if (timer.GetDurationSeconds() >= maxtime_sec) {
-                std::cerr << "Time out!" << std::endl;
+            if (time_check.Tick()) {
+                const std::int64_t elapsed_ms = timer.GetDurationMilliseconds();
+                time_check.Update(elapsed_ms);
+                if (elapsed_ms >= time_limit_ms) {
+                    std::cerr << "Time out!" << std::endl;
+                    stop_ = true;
+                }
+                if (elapsed_ms >= round_end_ms) {
+                    round_timeout_ = true;
+                }
+                if (checkpoint_ && checkpoint_ms > 0 && elapsed_ms >= next_checkpoint_ms) {
+                    WriteCheckpoint();
+                    next_checkpoint_ms = elapsed_ms + checkpoint_ms;
+                }
+            }
+            if (options_.max_steps > 0 && num_simulations_ >= options_.max_steps) {
                 stop_ = true;
             }
         } while (!ShouldStopRound());
 
         if (!found_bestcost_) {
-            temperature_ *= 0.9;
+            temperature_ *= cooling_;
         }
         if (found_bestcost_) {
             not_found_bestcost_accum_ = 0;
@@ -400,6 +812,225 @@ void Placer::RunSimulatedAnnealing() {
             not_found_bestcost_accum_ += 1;
         }
         UpdateCostFactorStage();
+        if (TryAdoptSharedBest() && batch) {
+            SyncBatchLanes(*batch);
+        }
+        if (options_.auto_cooling) {
+            UpdateSchedule(timer.GetDurationMilliseconds());
+        }
+        if (trace.is_open()) {
+            telemetry_.WriteCsvRow(trace, {num_iterations_,
+                                           timer.GetDurationMilliseconds(),
+                                           temperature_,
+                                           beta_reduction_stage_,
+                                           gen_cnt_,
+                                           reject_cnt_,
+                                           uphill_cnt_,
+                                           best_cost_,
+                                           best_area_,
+                                           {move_selector_.GetProb(MoveType::kRotateNode),
+                                            move_selector_.GetProb(MoveType::kSwapNode),
+                                            move_selector_.GetProb(MoveType::kGroupNode),
+                                            move_selector_.GetProb(MoveType::kMoveLeafNode)}});
+        }
+        telemetry_.EndRound();
+        if (options_.adaptive_moves) {
+            move_selector_.EndRound();
+        }
     } while (!ShouldStopRunning());
+
+    if (batch) {
+        FinishBatch(*batch);
+    }
+    if (verbose_) {
+        telemetry_.PrintSummary(std::cerr);
+    }
+}
+
+void Placer::RunParallelSimulatedAnnealing() {
+    const int num_threads = options_.num_threads;
+    // 初始解也是合法的擺放，先寫出來
+    WriteCheckpoint();
+    // 只有一個 block 且沒有對稱群時沒有任何擾動可以套用，步數永遠不會增加
+    if (hb_tree_.GetNumberNodes() < 2 && groups_.empty()) {
+        return;
+    }
+    if (num_threads <= 1) {
+        RunSimulatedAnnealing();
+        return;
+    }
+    if (options_.tempering) {
+        RunParallelTempering();
+        return;
+    }
+
+    SharedSolution shared;
+    shared.Reset(best_area_, hb_tree_, placement_);
+
+    // 每個 worker 有自己的 HB-tree 與亂數種子，第一個 worker 沿用目前的種子
+    std::vector<Placer> workers(num_threads, *this);
+    for (int i = 0; i < num_threads; ++i) {
+        if (i > 0) {
+            workers[i].rng_.SetSeed(rng_.Rand64());
+        }
+        workers[i].shared_ = &shared;
+        workers[i].verbose_ = (i == 0);
+        workers[i].checkpoint_ = (i == 0);
+    }
+
+    std::vector<std::thread> threads;
+    for (auto &worker: workers) {
+        threads.emplace_back([&worker]() { worker.RunSimulatedAnnealing(); });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    for (auto &worker: workers) {
+        if (worker.best_area_ < best_area_) {
+            best_area_ = worker.best_area_;
+            best_placement_ = worker.best_placement_;
+        }
+    }
+    std::cerr << "[INFO] best area of " << num_threads << " workers = " << best_area_ << "\n";
 }
 
+void Placer::RunParallelTempering() {
+    const int num_replicas = options_.num_threads;
+    TemperingContext ctx(num_replicas, rng_.Rand64());
+    ctx.phase_steps = std::clamp(table_.Size() * kExchangeSweeps,
+                                 kMinExchangeSteps, kMaxExchangeSteps);
+    ctx.beta_stage = beta_reduction_stage_;
+    ctx.next_checkpoint_ms = options_.checkpoint_interval_sec * 1000;
+
+    // 溫度由高到低等比排列，replica k 從第 k 熱的溫度開始
+    const double max_temperature = best_cost_ / 10.0;
+    const double ratio = std::pow(kTemperingMinRatio, 1.0 / (num_replicas - 1));
+    std::vector<Placer> replicas(num_replicas, *this);
+    for (int k = 0; k < num_replicas; ++k) {
+        Placer &replica = replicas[k];
+        if (k > 0) {
+            replica.rng_.SetSeed(rng_.Rand64());
+        }
+        replica.temperature_ = max_temperature * std::pow(ratio, k);
+        replica.verbose_ = false;
+        replica.checkpoint_ = false;
+        ctx.ladder.emplace_back(k);
+    }
+    ctx.coordinator = this;
+    ctx.replicas = &replicas;
+
+    std::vector<std::thread> threads;
+    for (auto &replica: replicas) {
+        threads.emplace_back([&replica, &ctx]() { replica.RunTemperingReplica(ctx); });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    if (verbose_) {
+        std::cerr << "[INFO] " << ctx.num_exchanges << " exchanges, acceptance between adjacent temperatures:";
+        for (int k = 0; k + 1 < num_replicas; ++k) {
+            std::cerr << " " << std::fixed << std::setprecision(2)
+                      << (ctx.attempts[k] > 0 ? (double)ctx.accepts[k] / ctx.attempts[k] : 0.0);
+        }
+        std::cerr << "\n";
+    }
+    std::cerr << "[INFO] best area of " << num_replicas << " replicas = " << best_area_ << "\n";
+}
+
+void Placer::RunTemperingReplica(TemperingContext &ctx) {
+    // 溫度固定，curr_cost_ 是目前狀態真正的 cost，交換時以它計算接受機率
+    hb_tree_.Pack(placement_);
+    hb_tree_.SaveSnapshot(placement_, snapshot_);
+    curr_cost_ = best_cost_;
+    num_simulations_ = 0;
+    stop_ = false;
+
+    const std::int64_t time_limit_ms = options_.time_limit_sec * 1000;
+    TimeCheckInterval time_check;
+
+    while (true) {
+        if (beta_reduction_stage_ != ctx.beta_stage) {
+            // cost 的定義改變了，重新計算目前狀態的 cost。狀態已經 pack 過，
+            // 只會重新計算線長
+            beta_reduction_stage_ = ctx.beta_stage;
+            curr_cost_ = ComputeCost(hb_tree_.Pack(placement_));
+            best_cost_ = curr_cost_;
+        }
+        for (int i = 0; i < ctx.phase_steps && !stop_; ++i) {
+            if (options_.adaptive_moves) {
+                const MoveType move_type = move_selector_.Select(rng_);
+                Timer move_timer;
+                RunMove(move_type);
+                move_selector_.RecordTime(move_type, move_timer.GetDurationNanoseconds());
+            } else {
+                RunMove(static_cast<MoveType>(rng_.RandInt(0, kNumMoveTypes - 1)));
+            }
+            if (time_check.Tick()) {
+                const std::int64_t elapsed_ms = ctx.timer.GetDurationMilliseconds();
+                time_check.Update(elapsed_ms);
+                if (elapsed_ms >= time_limit_ms) {
+                    stop_ = true;
+                }
+            }
+            if (options_.max_steps > 0 && num_simulations_ >= options_.max_steps) {
+                stop_ = true;
+            }
+        }
+        if (options_.adaptive_moves) {
+            move_selector_.EndRound();
+        }
+        ctx.barrier.ArriveAndWait([&ctx]() {
+            ctx.coordinator->ExchangeReplicas(ctx, *ctx.replicas);
+        });
+        if (ctx.stop) {
+            break;
+        }
+    }
+}
+
+void Placer::ExchangeReplicas(TemperingContext &ctx, std::vector<Placer> &replicas) {
+    // 其他 replica 都在 barrier 等待，這裡可以直接讀寫它們的狀態
+    const int num_replicas = replicas.size();
+
+    // 輪流嘗試 (0,1)(2,3)... 與 (1,2)(3,4)...，依照 Metropolis 準則交換溫度，
+    // 等同於交換兩個 replica 的狀態
+    for (int k = ctx.num_exchanges % 2; k + 1 < num_replicas; k += 2) {
+        Placer &hot = replicas[ctx.ladder[k]];
+        Placer &cold = replicas[ctx.ladder[k + 1]];
+        const double delta = (1.0 / hot.temperature_ - 1.0 / cold.temperature_) *
+                                 (hot.curr_cost_ - cold.curr_cost_);
+        ctx.attempts[k] += 1;
+        if (delta >= 0 || ctx.rng.Rand01() < std::exp(delta)) {
+            std::swap(hot.temperature_, cold.temperature_);
+            std::swap(ctx.ladder[k], ctx.ladder[k + 1]);
+            ctx.accepts[k] += 1;
+        }
+    }
+    ctx.num_exchanges += 1;
+
+    // 收集目前最小的面積，長時間沒有進步時進入下一個 beta stage
+    bool improved = false;
+    for (auto &replica: replicas) {
+        if (replica.best_area_ < best_area_) {
+            best_area_ = replica.best_area_;
+            best_placement_ = replica.best_placement_;
+            improved = true;
+        }
+        if (replica.stop_) {
+            ctx.stop = true;
+        }
+    }
+    ctx.stall_exchanges = improved ? 0 : ctx.stall_exchanges + 1;
+    if (ctx.stall_exchanges >= kStallExchanges && ctx.beta_stage < 4) {
+        ctx.beta_stage += 1;
+        ctx.stall_exchanges = 0;
+    }
+
+    const std::int64_t elapsed_ms = ctx.timer.GetDurationMilliseconds();
+    if (options_.checkpoint_interval_sec > 0 && elapsed_ms >= ctx.next_checkpoint_ms) {
+        WriteCheckpoint();
+        ctx.next_checkpoint_ms = elapsed_ms + options_.checkpoint_interval_sec * 1000;
+    }
+}
@@ -1,46 +1,153 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <limits>
 #include <vector>
 #include <string>
-#include <unordered_map>
 #include <cstdint>
 
 #include "types.hpp"
 #include "hb_tree.hpp"
+#include "move_selector.hpp"
+#include "telemetry.hpp"
+#include "utils.hpp"
+
+/*
+ * 多執行緒時所有 worker 共享的最佳解，包含可以接續 SA 的完整狀態。
+ * 讀寫都不會被其他 thread 阻塞：解存在 kNumSlots 個 slot 中，current_ 指向
+ * 最新的一個。寫入者挑一個不是 current_、也沒有人在讀的 slot 寫好後才更新
+ * current_；讀取者先在 current_ 的 slot 登記，確認 current_ 沒有改變後才複製。
+ * 同一時間只有一個寫入者，其他寫入者或是找不到空的 slot 時直接放棄這次寫入。
+ */
+class SharedSolution {
+public:
+    // 只能在 worker 開始前呼叫，所有 slot 都複製一份，之後複製時不必再配置記憶體
+    void Reset(std::int64_t area, const HbTree &hb_tree, const Placement &placement);
+
+    // 目前最小的面積，只讀一個 atomic，可以在 SA 迴圈中頻繁檢查
+    std::int64_t GetBestArea() const { return best_area_.load(std::memory_order_acquire); }
+
+    // area 比目前的最佳解小時寫入，回傳 false 表示這次放棄寫入
+    bool TryPublish(std::int64_t area, const HbTree &hb_tree, const Placement &placement);
+
+    // 複製目前的最佳解並回傳它的面積，hb_tree 為 nullptr 時只複製座標
+    std::int64_t Read(HbTree *hb_tree, Placement &placement) const;
+
+private:
+    static constexpr int kNumSlots = 3;
+
+    struct Slot {
+        std::int64_t area;
+        HbTree hb_tree;
+        Placement placement;
+    };
+
+    std::array<Slot, kNumSlots> slots_;
+    mutable std::array<std::atomic<int>, kNumSlots> readers_{}; // 正在讀每個 slot 的 thread 數
+    std::atomic<int> current_{0};
+    std::atomic<bool> writing_{false};
+    std::atomic<std::int64_t> best_area_{std::numeric_limits<std::int64_t>::max()};
+};
+
+/* 可由命令列調整的 SA 參數，預設值與作業提交時相同 */
+struct PlacerOptions {
+    double time_limit_sec{5 * 60 - 5}; // 5 秒當緩衝時間
+    bool has_seed{false};
+    std::uint64_t seed{0};
+    int num_threads{1};
+    double cooling{0.9};               // 一輪沒有進步時溫度乘上的比例
+    bool auto_cooling{false};          // 依照剩餘時間調整降溫比例與每輪長度
+    int round_factor{50};              // 每輪最多嘗試 block 數量 * round_factor 次上坡
+    int stop_rounds{50};               // 連續這麼多輪沒有進步就停止
+    std::int64_t max_steps{0};         // 最多模擬的步數，0 表示不限制
+    std::string checkpoint_path;       // 定期寫出目前最好的解，空字串表示不寫
+    double checkpoint_interval_sec{30};
+    std::string trace_path;            // 每輪的統計寫成 CSV，空字串表示不寫
+    bool adaptive_moves{false};        // 依照每種擾動的效益調整選擇機率
+    bool tempering{false};             // 多執行緒時以 replica exchange 取代獨立重啟
+    int batch_size{1};                 // 每步同時 pack 的候選擾動數，1 表示逐一評估
+};
+
+struct TemperingContext;
+struct BatchContext;
 
 class Placer {
 public:
-    Placer() = default;
+    Placer() : rng_(PRNG::RandomSeed()) {}
+    explicit Placer(const PlacerOptions &options);
     void ReadFile(const std::string& path);
     void RunSimulatedAnnealing();
+    void RunParallelSimulatedAnnealing();
     void WriteFile(const std::string& path);
+    void WriteCheckpoint();
+
+    // 讀檔後的初始資料，給 benchmark 等外部工具使用
+    const BlockTable& GetBlockTable() const { return table_; }
+    const Placement& GetPlacement() const { return placement_; }
+    const std::vector<SymmGroup>& GetGroups() const { return groups_; }
 
 private:
-    std::int64_t ComputeArea(std::vector<Block>& blocks);
-    std::int64_t ComputeTotalWirelength(const std::vector<Block>& blocks);
-    void ComputeBaseFactor(std::vector<Block>& blocks);
-    std::int64_t ComputeCost(std::vector<Block>& blocks);
+    void ComputeBaseFactor(const PackResult& result);
+    std::int64_t ComputeCost(const PackResult& result) const;
     void UpdateCostFactorStage();
 
     bool TryAcceptSimulation(double delta_area);
     int TryGetSymmMate(int idx) const;
-    void RotateNode();
-    void SwapNode();
-    void SwapOrRotateGroupNode();
-    void MoveLeafNode();
+    void EvaluateMove(MoveType type);
+    bool DecideMove(MoveType type,
+                    const PackResult& result,
+                    std::int64_t pack_ns,
+                    const HbTree& hb_tree,
+                    const Placement& placement);
+    void RunMove(MoveType type);
+
+    // 在 hb_tree 上套用一個擾動但不 pack，沒有可以做的擾動時回傳 false。
+    // 只讀 Placer 的固定資料，可以同時在不同的 HB-tree 複本上呼叫
+    bool ApplyMove(MoveType type, HbTree& hb_tree, Placement& placement, PRNG& rng) const;
+    bool RotateNode(HbTree& hb_tree, Placement& placement, PRNG& rng) const;
+    bool SwapNode(HbTree& hb_tree, PRNG& rng) const;
+    bool SwapOrRotateGroupNode(HbTree& hb_tree, Placement& placement, PRNG& rng) const;
+    bool MoveLeafNode(HbTree& hb_tree, PRNG& rng) const;
+
     void UpdateStats();
+    void PublishBest(const HbTree& hb_tree, const Placement& placement);
+    bool TryAdoptSharedBest();
+
+    // 批次評估：每步從目前的狀態產生 batch_size 個候選擾動，在各自的
+    // HB-tree 複本上同時 pack，再依照順序以 Metropolis 準則決定接受哪一個
+    void StartBatch(BatchContext &ctx);
+    void SyncBatchLanes(BatchContext &ctx);
+    void RunBatchStep(BatchContext &ctx);
+    void RunBatchLane(BatchContext &ctx, int idx) const;
+    void FinishBatch(BatchContext &ctx);
+
+    void WritePlacement(const std::string& path,
+                        std::int64_t area,
+                        const Placement& placement) const;
+    void UpdateSchedule(std::int64_t elapsed_ms);
 
     bool ShouldStopRound() const;
     bool ShouldStopRunning() const;
 
-    std::vector<Block> blocks_;       // 所有 HardBlock
+    // replica exchange：每個 replica 固定在梯子上的一個溫度，
+    // 所有 replica 跑完一段後交換相鄰溫度的狀態
+    void RunParallelTempering();
+    void RunTemperingReplica(TemperingContext &ctx);
+    void ExchangeReplicas(TemperingContext &ctx, std::vector<Placer> &replicas);
+
+    BlockTable table_;                // 所有 HardBlock 的名稱等固定資料
+    Placement placement_;             // 所有 HardBlock 目前的座標
     std::vector<SymmGroup> groups_;   // 對稱群
-    NameToIdMap blockname_to_id_map_; // block name -> idx
 
-    std::vector<Block> best_blocks_;  // 最好的 HardBlock
+    Placement best_placement_;        // 最好的 HardBlock 座標
     HbTree hb_tree_;
+    HbTree::Snapshot snapshot_;       // 目前接受的狀態
+    PRNG rng_;                        // 整個 SA 共用的亂數 context
 
     double temperature_;
+    double cooling_;                  // 這一輪沒有進步時溫度乘上的比例
+    std::int64_t round_gen_limit_;    // 每輪最多產生的擾動數
     std::int64_t best_cost_;
     std::int64_t curr_cost_;
     std::int64_t best_area_;
@@ -48,7 +155,7 @@ private:
     std::int64_t base_area_;
     std::int64_t base_hpwl_;
 
-    bool found_bestcost_;
+    bool found_bestcost_{false};
     int not_found_bestcost_accum_;
     int beta_reduction_stage_;
 
@@ -58,6 +165,14 @@ private:
     int gen_cnt_;
     int reject_cnt_;
     int uphill_cnt_;
-    bool stop_;
+    bool stop_{false};
+    bool round_timeout_{false};       // 這一輪用完了分配到的時間
+
+    PlacerOptions options_;
+    SharedSolution *shared_{nullptr}; // 多執行緒時共享的最佳解
+    bool checkpoint_{true};           // 多執行緒時只有一個 worker 寫 checkpoint 與 trace
+    Telemetry telemetry_;             // 每種擾動的接受率與 pack 時間
+    MoveSelector move_selector_;      // adaptive_moves 時選擇擾動
+    bool verbose_{true};
 };
 
@@ -0,0 +1,83 @@
+#include <iomanip>
+
+#include "telemetry.hpp"
+
+static const char *kMoveNames[kNumMoveTypes] = {
+    "rotate", "swap", "group", "leaf"
+};
+
+void MoveStats::Add(const MoveStats &other) {
+    generated += other.generated;
+    accepted += other.accepted;
+    uphill += other.uphill;
+    improving += other.improving;
+    pack_ns += other.pack_ns;
+}
+
+void Telemetry::WriteCsvHeader(std::ostream &out) {
+    out << "round,time_ms,temperature,beta_stage,gen_cnt,reject_cnt,uphill_cnt,"
+        << "best_cost,best_area";
+    for (const char *name: kMoveNames) {
+        out << "," << name << "_gen"
+            << "," << name << "_acc"
+            << "," << name << "_uphill"
+            << "," << name << "_improve"
+            << "," << name << "_pack_ns"
+            << "," << name << "_prob";
+    }
+    out << "\n";
+}
+
+void Telemetry::WriteCsvRow(std::ostream &out, const RoundStats &round) const {
+    out << round.round << ","
+        << round.time_ms << ","
+        << round.temperature << ","
+        << round.beta_stage << ","
+        << round.gen_cnt << ","
+        << round.reject_cnt << ","
+        << round.uphill_cnt << ","
+        << round.best_cost << ","
+        << round.best_area;
+    for (int i = 0; i < kNumMoveTypes; ++i) {
+        const MoveStats &stats = round_[i];
+        // pack 時間輸出這一輪的平均值
+        const std::int64_t mean_ns =
+            stats.generated > 0 ? stats.pack_ns / stats.generated : 0;
+        out << "," << stats.generated
+            << "," << stats.accepted
+            << "," << stats.uphill
+            << "," << stats.improving
+            << "," << mean_ns
+            << "," << round.move_prob[i];
+    }
+    out << "\n";
+}
+
+void Telemetry::EndRound() {
+    for (int i = 0; i < kNumMoveTypes; ++i) {
+        total_[i].Add(round_[i]);
+        round_[i] = MoveStats{};
+    }
+}
+
+void Telemetry::PrintSummary(std::ostream &out) const {
+    out << "[INFO] move     generated   accept%   uphill%  improve%";
+    if (timing_) {
+        out << "   pack(ns)";
+    }
+    out << "\n";
+    for (int i = 0; i < kNumMoveTypes; ++i) {
+        const MoveStats &stats = total_[i];
+        const double gen = stats.generated > 0 ? stats.generated : 1;
+        out << "[INFO] " << std::left << std::setw(6) << kMoveNames[i] << std::right
+            << std::fixed << std::setprecision(2)
+            << std::setw(12) << stats.generated
+            << std::setw(10) << 100.0 * stats.accepted / gen
+            << std::setw(10) << 100.0 * stats.uphill / gen
+            << std::setw(10) << 100.0 * stats.improving / gen;
+        if (timing_) {
+            out << std::setw(11) << stats.pack_ns / (std::int64_t)gen;
+        }
+        out << "\n";
+    }
+}
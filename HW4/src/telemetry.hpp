@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+/* SA 的四種擾動 */
+enum class MoveType {
+    kRotateNode,
+    kSwapNode,
+    kGroupNode,   // SwapOrRotateGroupNode
+    kMoveLeafNode,
+    kNumTypes
+};
+
+constexpr int kNumMoveTypes = static_cast<int>(MoveType::kNumTypes);
+
+/* 一種擾動的累計次數與 pack 時間 */
+struct MoveStats {
+    std::int64_t generated{0};
+    std::int64_t accepted{0};
+    std::int64_t uphill{0};    // 接受的上坡擾動
+    std::int64_t improving{0}; // cost 下降的擾動
+    std::int64_t pack_ns{0};   // 只有開啟 trace 時才量測
+
+    void Add(const MoveStats &other);
+};
+
+/* 一輪 (同一個溫度) 結束時的狀態 */
+struct RoundStats {
+    int round;
+    std::int64_t time_ms;
+    double temperature;
+    int beta_stage;
+    int gen_cnt;
+    int reject_cnt;
+    int uphill_cnt;
+    std::int64_t best_cost;
+    std::int64_t best_area;
+    std::array<double, kNumMoveTypes> move_prob; // 這一輪選擇各擾動的機率
+};
+
+/*
+ * 統計每種擾動的接受率與 pack 時間。計數一律開啟，成本只是幾個加法；
+ * 量測 pack 時間需要讀時鐘，只有在輸出 trace 時才開啟。
+ * 每輪結束時把該輪的統計寫成 CSV 的一行，再累加到總計中。
+ */
+class Telemetry {
+public:
+    inline void SetTiming(bool timing) { timing_ = timing; }
+    inline bool Timing() const { return timing_; }
+
+    inline void RecordMove(MoveType type, bool accepted,
+                           std::int64_t delta_cost, std::int64_t pack_ns) {
+        MoveStats &stats = round_[static_cast<int>(type)];
+        stats.generated += 1;
+        stats.accepted += accepted;
+        stats.uphill += accepted && delta_cost > 0;
+        stats.improving += delta_cost < 0;
+        stats.pack_ns += pack_ns;
+    }
+
+    static void WriteCsvHeader(std::ostream &out);
+    void WriteCsvRow(std::ostream &out, const RoundStats &round) const;
+
+    // 把這一輪的統計加到總計並清空
+    void EndRound();
+
+    void PrintSummary(std::ostream &out) const;
+
+private:
+    bool timing_{false};
+    std::array<MoveStats, kNumMoveTypes> round_{};
+    std::array<MoveStats, kNumMoveTypes> total_{};
+};
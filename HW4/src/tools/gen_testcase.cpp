@@ -0,0 +1,86 @@
+/*
+ * 產生與 testcase 相同格式的合成測資，用來測試 placer 與 verifier 在大量
+ * block 時的表現。產生的方式見 testcase_gen.hpp。
+ *
+ *     ./gen_testcase [options] > out.txt
+ */
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "testcase_gen.hpp"
+
+namespace {
+
+void PrintUsage() {
+    std::cout << "usage: ./gen_testcase [options] > out.txt\n"
+              << "  --blocks N        block 數量，預設 1000\n"
+              << "  --groups G        對稱群數量，預設 10\n"
+              << "  --group-min S     每個對稱群最少的 block 數，預設 4\n"
+              << "  --group-max S     每個對稱群最多的 block 數，預設 32\n"
+              << "  --self-frac F     對稱群中 self-symmetric block 的比例，預設 0.2\n"
+              << "  --min-size L      block 等面積正方形的最小邊長，預設 10\n"
+              << "  --max-size L      block 等面積正方形的最大邊長，預設 200\n"
+              << "  --aspect R        最大長寬比，預設 3\n"
+              << "  --seed N          亂數種子，預設 1\n"
+              << "  -o FILE           輸出檔，預設為 stdout\n";
+}
+
+bool ParseArgs(int argc, const char ** argv, GenOptions &options, std::string &output) {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string val = argv[++i];
+            if (arg == "--blocks") {
+                options.num_blocks = std::stoi(val);
+            } else if (arg == "--groups") {
+                options.num_groups = std::stoi(val);
+            } else if (arg == "--group-min") {
+                options.group_min = std::stoi(val);
+            } else if (arg == "--group-max") {
+                options.group_max = std::stoi(val);
+            } else if (arg == "--self-frac") {
+                options.self_frac = std::stod(val);
+            } else if (arg == "--min-size") {
+                options.min_size = std::stoi(val);
+            } else if (arg == "--max-size") {
+                options.max_size = std::stoi(val);
+            } else if (arg == "--aspect") {
+                options.max_aspect = std::stod(val);
+            } else if (arg == "--seed") {
+                options.seed = std::stoull(val);
+            } else if (arg == "-o") {
+                output = val;
+            } else {
+                return false;
+            }
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+    return IsValid(options);
+}
+
+} // namespace
+
+int main(int argc, const char ** argv) {
+    GenOptions options;
+    std::string output; // 空字串表示寫到 stdout
+    if (!ParseArgs(argc, argv, options, output)) {
+        PrintUsage(); return -1;
+    }
+    const std::string text = GenerateTestcase(options);
+    if (output.empty()) {
+        std::cout << text;
+        return 0;
+    }
+    std::ofstream fout(output);
+    if (!fout) {
+        std::cerr << "output open failed\n"; return -1;
+    }
+    fout << text;
+    return 0;
+}
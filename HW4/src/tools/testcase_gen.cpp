@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "testcase_gen.hpp"
+#include "utils.hpp"
+
+namespace {
+
+/* 依照邊長與長寬比的分布產生一個 block，even 為 true 時寬高都是偶數 */
+std::pair<int, int> RandomShape(PRNG &rng, const GenOptions &options, bool even) {
+    const double side = options.min_size +
+        rng.Rand01() * (options.max_size - options.min_size);
+    const double log_aspect = std::log(options.max_aspect) * (2.0 * rng.Rand01() - 1.0);
+    const double aspect = std::exp(log_aspect);
+    int w = std::max(1, (int)std::lround(side * std::sqrt(aspect)));
+    int h = std::max(1, (int)std::lround(side / std::sqrt(aspect)));
+    if (even) {
+        w += w & 1;
+        h += h & 1;
+    }
+    return {w, h};
+}
+
+} // namespace
+
+bool IsValid(const GenOptions &options) {
+    return options.num_blocks >= 1 &&
+               options.num_groups >= 0 &&
+               options.group_min >= 1 &&
+               options.group_max >= options.group_min &&
+               options.self_frac >= 0 && options.self_frac <= 1 &&
+               options.min_size >= 2 &&
+               options.max_size >= options.min_size &&
+               options.max_aspect >= 1 &&
+               options.seed != 0;
+}
+
+std::string GenerateTestcase(const GenOptions &options) {
+    PRNG rng(options.seed);
+    const int n = options.num_blocks;
+
+    // 1. 決定每個對稱群的成員數量，總數不超過 block 數量
+    std::vector<int> group_sizes;
+    int grouped = 0;
+    for (int g = 0; g < options.num_groups; ++g) {
+        const int size = std::min(rng.RandInt(options.group_min, options.group_max),
+                                  n - grouped);
+        if (size <= 0) {
+            break;
+        }
+        group_sizes.emplace_back(size);
+        grouped += size;
+    }
+
+    // 2. 隨機排列 block，依序分給各個對稱群，剩下的是單獨的 block
+    std::vector<int> order(n);
+    for (int i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::vector<std::pair<int, int>> shapes(n);
+    std::vector<std::string> lines; // SymGroup 部份
+    int next = 0;
+    for (size_t g = 0; g < group_sizes.size(); ++g) {
+        const int size = group_sizes[g];
+        int num_selfs = std::lround(size * options.self_frac);
+        // 剩下的成員兩兩成對，數量是奇數時多出的一個改成 self-symmetric
+        if ((size - num_selfs) % 2 != 0) {
+            num_selfs += 1;
+        }
+        const int num_pairs = (size - num_selfs) / 2;
+
+        lines.emplace_back("SymGroup sg" + std::to_string(g) + " " +
+                               std::to_string(num_pairs + num_selfs));
+        for (int p = 0; p < num_pairs; ++p) {
+            const int a = order[next++];
+            const int b = order[next++];
+            shapes[a] = RandomShape(rng, options, false);
+            shapes[b] = shapes[a];
+            if (rng.RandInt(0, 3) == 0) {
+                std::swap(shapes[b].first, shapes[b].second);
+            }
+            lines.emplace_back("SymPair m" + std::to_string(a + 1) +
+                                   " m" + std::to_string(b + 1));
+        }
+        for (int s = 0; s < num_selfs; ++s) {
+            const int a = order[next++];
+            shapes[a] = RandomShape(rng, options, true);
+            lines.emplace_back("SymSelf m" + std::to_string(a + 1));
+        }
+    }
+    for (; next < n; ++next) {
+        shapes[order[next]] = RandomShape(rng, options, false);
+    }
+
+    std::ostringstream out;
+    out << "NumHardBlocks " << n << "\n";
+    for (int i = 0; i < n; ++i) {
+        out << "HardBlock m" << i + 1 << " "
+                << shapes[i].first << " " << shapes[i].second << "\n";
+    }
+    out << "NumSymGroups " << group_sizes.size() << "\n";
+    for (const auto &line: lines) {
+        out << line << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*
+ * 產生與 testcase 相同格式的合成測資，gen_testcase 與 benchmark 共用。
+ *
+ * 對稱群的成員從所有 block 中隨機挑選，symmetry pair 的兩個 block 大小相同
+ * （其中一些會預先旋轉，用來測試讀檔時的旋轉處理），self-symmetric block
+ * 的寬高都是偶數，不論對稱軸是哪個方向都可以對半切。
+ */
+struct GenOptions {
+    int num_blocks{1000};
+    int num_groups{10};
+    int group_min{4};          // 每個對稱群最少的 block 數
+    int group_max{32};         // 每個對稱群最多的 block 數
+    double self_frac{0.2};     // 對稱群中 self-symmetric block 的比例
+    int min_size{10};          // 面積開根號後的最小邊長
+    int max_size{200};         // 面積開根號後的最大邊長
+    double max_aspect{3.0};    // 長寬比在 [1/max_aspect, max_aspect] 之間 log-uniform
+    std::uint64_t seed{1};
+};
+
+// 參數是否合法，不合法時 GenerateTestcase 的結果沒有定義
+bool IsValid(const GenOptions &options);
+
+// 相同的參數與種子一定得到相同的內容
+std::string GenerateTestcase(const GenOptions &options);
@@ -1,27 +1,54 @@
 #pragma once
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include <cstdint>
+#include <utility>
 
 #include "BStarTree.hpp"
 
-struct Block {
-    Block() = default;
-    Block(std::string n, int width, int height) : name(n), w(width), h(height) {}
+/* 不會在 SA 過程中改變的 block 資料，只有讀寫檔與初始化時需要 */
+struct BlockTable {
+    std::vector<std::string> names;
+    std::vector<int> gids;         // 所屬的對稱群，-1 表示單獨的 block
+    std::vector<bool> pre_rotated; // 讀檔時為了讓 pair 等寬而預先旋轉
 
-    std::string name;
-    int w, h;
-    int x{0}, y{0};
-    int gid{-1};
-    bool rotated{false};
-    bool pre_rotated{false};
-
-    inline int GetRotatedWidth() const { return rotated ? h : w; }
-    inline int GetRotatedHeight() const { return rotated ? w : h; }
-    inline void PreRotate() { std::swap(h, w); pre_rotated = !pre_rotated; }
-    inline void Rotate() { rotated = !rotated; }
-    inline bool IsSolo() const { return gid == -1; }
+    inline int Size() const { return names.size(); }
+    inline bool IsSolo(int i) const { return gids[i] == -1; }
+};
+
+/* SA 過程中會改變的 block 資料，以 structure of arrays 存放，整份複製只需要 memcpy */
+struct Placement {
+    std::vector<std::int32_t> x, y;
+    std::vector<std::int32_t> w, h;
+    std::vector<std::uint64_t> rotated; // 每個 bit 代表一個 block 是否旋轉
+
+    inline int Size() const { return x.size(); }
+    inline void Reserve(int n) {
+        x.reserve(n);
+        y.reserve(n);
+        w.reserve(n);
+        h.reserve(n);
+        rotated.reserve((n + 63) / 64);
+    }
+    inline void Add(int width, int height) {
+        x.emplace_back(0);
+        y.emplace_back(0);
+        w.emplace_back(width);
+        h.emplace_back(height);
+        rotated.resize((x.size() + 63) / 64, 0);
+    }
+
+    inline bool IsRotated(int i) const { return (rotated[i >> 6] >> (i & 63)) & 1; }
+    inline void Rotate(int i) { rotated[i >> 6] ^= std::uint64_t(1) << (i & 63); }
+    inline void SetRotated(int i, bool r) {
+        if (IsRotated(i) != r) {
+            Rotate(i);
+        }
+    }
+    inline void PreRotate(int i) { std::swap(w[i], h[i]); }
+
+    inline int GetRotatedWidth(int i) const { return IsRotated(i) ? h[i] : w[i]; }
+    inline int GetRotatedHeight(int i) const { return IsRotated(i) ? w[i] : h[i]; }
 };
 
 
@@ -49,8 +76,9 @@ struct SymmGroup {
     std::vector<SymmSelf> selfs;
 };
 
-using NameToIdMap = std::unordered_map<std::string, size_t>;
 using IdType = std::int64_t;
 using NodeType = Node<IdType>;
-using NodePointer = Node<IdType>*;
-using NodePointerList = std::vector<NodePointer>;
+using NodeIndex = std::int32_t;
+using NodeIndexList = std::vector<NodeIndex>;
+using NodeArenaType = NodeArena<IdType>;
+using TreeType = BStarTree<IdType>;
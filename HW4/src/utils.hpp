@@ -7,8 +7,7 @@
 #include <random>
 #include <thread>
 #include <vector>
-#include <functional>
-#include <unordered_set>
+#include <utility>
 
 #include "types.hpp"
 
@@ -53,10 +52,11 @@ class PRNG : public RandomBase {
 public:
     PRNG(std::uint64_t seed) : s_(seed) { assert(seed); }
 
-    static PRNG &Get() {
-        std::random_device rd_;
-        static thread_local PRNG rng(rd_());
-        return rng;
+    // 只在建立 context 時讀取一次 random_device
+    static std::uint64_t RandomSeed() {
+        std::random_device rd;
+        std::uint64_t seed = ((std::uint64_t)rd() << 32) | rd();
+        return seed ? seed : 1;
     }
 
     constexpr std::uint64_t Rand64() {
@@ -80,6 +80,27 @@ public:
 
     virtual std::uint64_t operator()() { return Rand64(); }
 
+    // [l, r] 的均勻整數，使用 Lemire 的 multiply-shift 方法，
+    // 只有極少數情況需要重抽來去除偏差
+    int RandInt(int l, int r) {
+        const std::uint32_t range = (std::uint32_t)(r - l) + 1;
+        std::uint64_t m = (Rand64() >> 32) * range;
+        std::uint32_t low = (std::uint32_t)m;
+        if (low < range) {
+            const std::uint32_t threshold = -range % range;
+            while (low < threshold) {
+                m = (Rand64() >> 32) * range;
+                low = (std::uint32_t)m;
+            }
+        }
+        return l + (int)(m >> 32);
+    }
+
+    // [0, 1) 的均勻浮點數，取 53 個 bits
+    double Rand01() {
+        return (Rand64() >> 11) * 0x1.0p-53;
+    }
+
 private:
     std::uint64_t s_;
 };
@@ -107,159 +128,146 @@ public:
             std::chrono::duration_cast<std::chrono::milliseconds>(end_time - clock_time_).count();
         return milliseconds;
     }
+    std::int64_t GetDurationNanoseconds() const {
+        const auto end_time =
+            std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - clock_time_).count();
+    }
 
 private:
     std::chrono::steady_clock::time_point clock_time_;
 };
 
 
-inline int RandInt(int l, int r) {
-    std::uniform_int_distribution<int> dist(l,r);
-    return dist(PRNG::Get());
-}
-inline double Rand01() {
-    std::uniform_real_distribution<double> dist(0,1);
-    return dist(PRNG::Get());
-}
-inline std::vector<int> RandSample(int l, int r, int size) {
-    std::vector<int> result;
-    std::unordered_set<int> seen;
-    do {
-        result.clear();
-        seen.clear();
-
-        for (int i = 0; i < size; ++i) {
-            int val = RandInt(l, r);
-            result.push_back(val);
-            seen.insert(val);
-        }
-    } while ((int)seen.size() < size);  // 如果有重複，就重試
-    return result;
-}
-inline std::uint64_t GetCurrentSeed() {
-    return PRNG::Get().GetSeed();
-}
-inline void SetCurrentSeed(std::uint64_t seed) {
-    PRNG::Get().SetSeed(seed);
+// [l, r] 中兩個不同的均勻整數，先抽 a，再從剩下的 r - l 個數中抽 b，
+// 不需要重抽也不需要額外的記憶體
+inline std::pair<int, int> RandSamplePair(PRNG &rng, int l, int r) {
+    const int a = rng.RandInt(l, r);
+    int b = rng.RandInt(l, r - 1);
+    if (b >= a) {
+        b += 1;
+    }
+    return {a, b};
 }
 
-inline NodePointer BuildBalancedTree(NodePointerList& nodes) {
-    std::function<NodePointer(NodePointer, int, int)> BuildBalanced = 
-        [&](NodePointer parent, int l, int r) -> NodePointer {
-            if (l > r) return nullptr;
-            int m = (l + r) / 2;
-            NodePointer node = nodes[m];
-            node->parent = parent;
-            node->lchild = BuildBalanced(node, l, m - 1);
-            node->rchild = BuildBalanced(node, m + 1, r);
-            return node;
-        };
-    NodePointer root = BuildBalanced(nullptr, 0, (int)nodes.size() - 1);
-    return root;
+// nodes[l..r] 建成平衡樹，遞迴深度只有 log(n)
+inline NodeIndex BuildBalancedSubtree(NodeArenaType& arena, const NodeIndexList& nodes,
+                                      NodeIndex parent, int l, int r) {
+    if (l > r) return nullNode;
+    int m = (l + r) / 2;
+    NodeIndex node = nodes[m];
+    arena[node].parent = parent;
+    arena[node].lchild = BuildBalancedSubtree(arena, nodes, node, l, m - 1);
+    arena[node].rchild = BuildBalancedSubtree(arena, nodes, node, m + 1, r);
+    return node;
 }
-inline NodePointer BuildLeftSkewedTree(NodePointerList& nodes) {
-    std::function<NodePointer(NodePointer, int)> BuildLeftSkewed =
-        [&](NodePointer parent, int idx) -> NodePointer {
-            if (idx >= (int)nodes.size()) return nullptr;
-            NodePointer node = nodes[idx];
-            node->parent = parent;
-            node->lchild = BuildLeftSkewed(node, idx + 1);
-            node->rchild = nullptr;
-            return node;
-        };
-    NodePointer root = BuildLeftSkewed(nullptr, 0);
-    return root;
+inline NodeIndex BuildBalancedTree(NodeArenaType& arena, NodeIndexList& nodes) {
+    return BuildBalancedSubtree(arena, nodes, nullNode, 0, (int)nodes.size() - 1);
 }
-inline NodePointer BuildRightSkewedTree(NodePointerList& nodes) {
-    std::function<NodePointer(NodePointer, int)> BuildRightSkewed =
-        [&](NodePointer parent, int idx) -> NodePointer {
-            if (idx >= (int)nodes.size()) return nullptr;
-            NodePointer node = nodes[idx];
-            node->parent = parent;
-            node->lchild = nullptr;
-            node->rchild = BuildRightSkewed(node, idx + 1);
-            return node;
-        };
-    NodePointer root = BuildRightSkewed(nullptr, 0);
-    return root;
+// 斜樹的深度是 n，用迴圈建立，避免 block 很多時遞迴太深
+inline NodeIndex BuildLeftSkewedTree(NodeArenaType& arena, NodeIndexList& nodes) {
+    NodeIndex parent = nullNode;
+    for (NodeIndex node: nodes) {
+        arena[node].parent = parent;
+        arena[node].lchild = nullNode;
+        arena[node].rchild = nullNode;
+        if (parent != nullNode) {
+            arena[parent].lchild = node;
+        }
+        parent = node;
+    }
+    return nodes.empty() ? nullNode : nodes[0];
 }
-inline void ReplaceParentChild(NodePointer parent,
-                               NodePointer old_child,
-                               NodePointer new_child) {
-    if (!parent) {
+inline NodeIndex BuildRightSkewedTree(NodeArenaType& arena, NodeIndexList& nodes) {
+    NodeIndex parent = nullNode;
+    for (NodeIndex node: nodes) {
+        arena[node].parent = parent;
+        arena[node].lchild = nullNode;
+        arena[node].rchild = nullNode;
+        if (parent != nullNode) {
+            arena[parent].rchild = node;
+        }
+        parent = node;
+    }
+    return nodes.empty() ? nullNode : nodes[0];
+}
+inline void ReplaceParentChild(NodeArenaType& arena,
+                               NodeIndex parent,
+                               NodeIndex old_child,
+                               NodeIndex new_child) {
+    if (parent == nullNode) {
         return;
     }
-    if (parent->lchild == old_child) {
-        parent->lchild = new_child;
+    if (arena[parent].lchild == old_child) {
+        arena[parent].lchild = new_child;
     }
-    if (parent->rchild == old_child) {
-        parent->rchild = new_child;
+    if (arena[parent].rchild == old_child) {
+        arena[parent].rchild = new_child;
     }
 }
-inline void SwapNodeDirection(NodePointer src, NodePointer dst) {
+inline void SwapNodeDirection(NodeArenaType& arena, NodeIndex src, NodeIndex dst) {
+    NodeType &s = arena[src];
+    NodeType &d = arena[dst];
+
     // 更新 parent 指向
-    if (src->parent != dst->parent) {
-        ReplaceParentChild(src->parent, src, dst);
-        ReplaceParentChild(dst->parent, dst, src);
+    if (s.parent != d.parent) {
+        ReplaceParentChild(arena, s.parent, src, dst);
+        ReplaceParentChild(arena, d.parent, dst, src);
     } else {
-        std::swap(src->parent->lchild, dst->parent->rchild);
+        std::swap(arena[s.parent].lchild, arena[d.parent].rchild);
     }
 
     // 交換  parent lchild 與 rchild
-    std::swap(src->parent, dst->parent);
-    std::swap(src->lchild, dst->lchild);
-    std::swap(src->rchild, dst->rchild);
+    std::swap(s.parent, d.parent);
+    std::swap(s.lchild, d.lchild);
+    std::swap(s.rchild, d.rchild);
 
     // 更新孩子們的 parent 指向
-    if (src->lchild) src->lchild->parent = src;
-    if (src->rchild) src->rchild->parent = src;
-    if (dst->lchild) dst->lchild->parent = dst;
-    if (dst->rchild) dst->rchild->parent = dst;
-}
-inline void MirrorTree(NodePointer n) {
-    if (n) {
-        std::swap(n->lchild, n->rchild);
-        MirrorTree(n->lchild);
-        MirrorTree(n->rchild);
-    }
+    if (s.lchild != nullNode) arena[s.lchild].parent = src;
+    if (s.rchild != nullNode) arena[s.rchild].parent = src;
+    if (d.lchild != nullNode) arena[d.lchild].parent = dst;
+    if (d.rchild != nullNode) arena[d.rchild].parent = dst;
 }
-
 class RotateNodeOp {
 public:
-    void Apply(std::vector<Block>& blocks, NodePointerList& nodes) {
+    void Apply(PRNG &rng, const NodeArenaType& arena, Placement& placement, NodeIndexList& nodes) {
         num_nodes_ = nodes.size();
         if (!Valid()) {
             return;
         }
-        NodePointer n = nodes[RandInt(0, num_nodes_ - 1)];
-        block_ = &blocks[n->blockId];
-        block_->Rotate();
+        NodeIndex n = nodes[rng.RandInt(0, num_nodes_ - 1)];
+        placement_ = &placement;
+        block_id_ = arena[n].blockId;
+        placement_->Rotate(block_id_);
     }
     void Undo() {
         if (!Valid()) {
             return;
         }
-        block_->Rotate();
+        placement_->Rotate(block_id_);
     }
     bool Valid() const {
         return num_nodes_ >= 1;
     }
 private:
     int num_nodes_{0};
-    Block * block_{nullptr};
+    Placement * placement_{nullptr};
+    int block_id_{-1};
 };
 
 class SwapNodeOp {
 public:
-    void Apply(NodePointer *root, NodePointerList& nodes) {
+    void Apply(PRNG &rng, NodeArenaType *arena, TreeType *tree, NodeIndex *root, NodeIndexList& nodes) {
         num_nodes_ = nodes.size();
         if (!Valid()) {
             return;
         }
 
-        auto buf = RandSample(0, num_nodes_-1, 2);
-        src_ = nodes[buf[0]];
-        dst_ = nodes[buf[1]];
+        const auto [a, b] = RandSamplePair(rng, 0, num_nodes_ - 1);
+        src_ = nodes[a];
+        dst_ = nodes[b];
+        arena_ = arena;
+        tree_ = tree;
         root_ = root;
 
         if (*root_ == src_) {
@@ -267,7 +275,8 @@ public:
         } else if (*root_ == dst_) {
             *root_ = src_;
         }
-        SwapNodeDirection(src_, dst_);
+        SwapNodeDirection(*arena_, src_, dst_);
+        Touch();
     }
     void Undo() {
         if (!Valid()) {
@@ -278,106 +287,117 @@ public:
         } else if (*root_ == dst_) {
             *root_ = src_;
         }
-        SwapNodeDirection(src_, dst_);
+        SwapNodeDirection(*arena_, src_, dst_);
+        Touch();
     }
     bool Valid() const {
         return num_nodes_ >= 2;
     }
 
 private:
+    // 兩個節點與其 parent 的連結都改變了，children 在 preorder 中排在後面。
+    // 兩個節點交換了 children，parent 的 child 數量不變
+    void Touch() {
+        tree_->updateSlots(*arena_, src_);
+        tree_->updateSlots(*arena_, dst_);
+        tree_->touch(*arena_, src_);
+        tree_->touch(*arena_, dst_);
+        tree_->touch(*arena_, (*arena_)[src_].parent);
+        tree_->touch(*arena_, (*arena_)[dst_].parent);
+    }
+
     int num_nodes_{0};
-    NodePointer *root_{nullptr};
-    NodePointer src_{nullptr}, dst_{nullptr};
+    NodeArenaType *arena_{nullptr};
+    TreeType *tree_{nullptr};
+    NodeIndex *root_{nullptr};
+    NodeIndex src_{nullNode}, dst_{nullNode};
 };
 
 class LeafMoveOp {
 public:
    LeafMoveOp() = default;
 
-    void Apply(NodePointer root) {
-        if (!root) {
+    void Apply(PRNG &rng, NodeArenaType *arena, TreeType *tree, NodeIndex root) {
+        if (root == nullNode) {
             return;
         }
-        std::function<void(NodePointer, NodePointerList&)> GatherAllLeafNodes =
-            [&] (NodePointer node, NodePointerList &buf) {
-            if (node) {
-                if (!node->lchild && !node->rchild) {
-                    buf.emplace_back(node);
-                } else {
-                    GatherAllLeafNodes(node->lchild, buf);
-                    GatherAllLeafNodes(node->rchild, buf);
-                }
-            }
-        };
-        NodePointerList leaves;
-        GatherAllLeafNodes(root, leaves);
-
-        // 隨機選擇葉節點
-        leaf_ = leaves[RandInt(0, (int)leaves.size() - 1)];
-        old_parent_ = leaf_->parent;
-        was_left_child_ =
-            (old_parent_ && old_parent_->lchild == leaf_);
+        arena_ = arena;
+        tree_ = tree;
+        NodeArenaType &nodes = *arena_;
+
+        // 隨機選擇葉節點，tree 會記錄所有的葉節點
+        const NodeIndexList &leaves = tree_->getLeaves();
+        leaf_ = leaves[rng.RandInt(0, (int)leaves.size() - 1)];
+        old_parent_ = nodes[leaf_].parent;
+        if (old_parent_ == nullNode) {
+            return; // 只有一個節點，沒有地方可以移動
+        }
+        was_left_child_ = nodes[old_parent_].lchild == leaf_;
 
         // 將葉節點從舊位置移除
         if (was_left_child_) {
-            old_parent_->lchild = nullptr;
+            nodes[old_parent_].lchild = nullNode;
         } else {
-            old_parent_->rchild = nullptr;
+            nodes[old_parent_].rchild = nullNode;
         }
-        leaf_->parent = nullptr;
-
-        // 找可插入的新位置
-        NodePointerList candidates;
-        std::function<void(NodePointer, NodePointerList&)> Collect =
-            [&] (NodePointer node, NodePointerList &buf) {
-            if (!node) return;
-            if (!node->lchild || !node->rchild) {
-                if (node != leaf_) { candidates.push_back(node); } // 避免插入自己
-            }
-            Collect(node->lchild, buf);
-            Collect(node->rchild, buf);
-        };
-        Collect(root, candidates);
+        nodes[leaf_].parent = nullNode;
+        tree_->eraseSlots(nodes, leaf_);
+        tree_->updateSlots(nodes, old_parent_);
 
-        if (candidates.empty()) {
-            return;
-        }
-        new_parent_ = candidates[RandInt(0, (int)candidates.size() - 1)];
-        inserted_as_left_ = !new_parent_->lchild;
+        // 從還有空 child 的節點中隨機選一個插入，至少有 old_parent 可以選
+        const NodeIndexList &candidates = tree_->getOpenSlots();
+        new_parent_ = candidates[rng.RandInt(0, (int)candidates.size() - 1)];
+        inserted_as_left_ = nodes[new_parent_].lchild == nullNode;
 
         // 插入
         if (inserted_as_left_) {
-            new_parent_->lchild = leaf_;
+            nodes[new_parent_].lchild = leaf_;
         } else {
-            new_parent_->rchild = leaf_;
+            nodes[new_parent_].rchild = leaf_;
         }
-        leaf_->parent = new_parent_;
+        nodes[leaf_].parent = new_parent_;
+        tree_->updateSlots(nodes, new_parent_);
+        tree_->updateSlots(nodes, leaf_);
+        Touch();
     }
     void Undo() const {
+        NodeArenaType &nodes = *arena_;
+
         // 從新位置移除
         if (inserted_as_left_) {
-            new_parent_->lchild = nullptr;
+            nodes[new_parent_].lchild = nullNode;
         } else {
-            new_parent_->rchild = nullptr;
+            nodes[new_parent_].rchild = nullNode;
         }
+        tree_->updateSlots(nodes, new_parent_);
 
         // 還原到舊位置
         if (was_left_child_) {
-            old_parent_->lchild = leaf_;
+            nodes[old_parent_].lchild = leaf_;
         } else {
-            old_parent_->rchild = leaf_;
+            nodes[old_parent_].rchild = leaf_;
         }
-        leaf_->parent = old_parent_;
+        nodes[leaf_].parent = old_parent_;
+        tree_->updateSlots(nodes, old_parent_);
+        Touch();
     }
     bool Valid() const {
-        return new_parent_ != nullptr;
+        return new_parent_ != nullNode;
     }
 
 private:
-    NodePointer leaf_{nullptr};
-    NodePointer old_parent_{nullptr};
+    void Touch() const {
+        tree_->touch(*arena_, leaf_);
+        tree_->touch(*arena_, old_parent_);
+        tree_->touch(*arena_, new_parent_);
+    }
+
+    NodeArenaType *arena_{nullptr};
+    TreeType *tree_{nullptr};
+    NodeIndex leaf_{nullNode};
+    NodeIndex old_parent_{nullNode};
     bool was_left_child_{false};
 
-    NodePointer new_parent_{nullptr};
+    NodeIndex new_parent_{nullNode};
     bool inserted_as_left_{false};
 };
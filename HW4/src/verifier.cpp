@@ -0,0 +1,142 @@
+#include <algorithm>
+
+#include "geometry.hpp"
+#include "verifier.hpp"
+
+namespace {
+
+void AddError(VerifyResult &result, const std::string &message) {
+    result.legal = false;
+    result.num_errors += 1;
+    if ((int)result.errors.size() < VerifyResult::kMaxErrors) {
+        result.errors.emplace_back("[Error] " + message);
+    }
+}
+
+/*
+ * 以 axis 為對稱軸檢查一個對稱群，座標都乘二避免出現半格。水平軸時把 x 與 y、
+ * 寬與高互換後用同一套檢查。通過時回傳 true，失敗的原因寫在 message
+ */
+bool CheckGroupAxis(const SymmGroup &group,
+                    Axis axis,
+                    const std::vector<std::int32_t> &x,
+                    const std::vector<std::int32_t> &y,
+                    const std::vector<std::int32_t> &w,
+                    const std::vector<std::int32_t> &h,
+                    const BlockTable &table,
+                    std::string &message) {
+    const bool vertical = (axis == Axis::kVertical);
+    const auto &along = vertical ? x : y;  // 與對稱軸垂直的座標
+    const auto &across = vertical ? y : x; // 與對稱軸平行的座標
+    const auto &size = vertical ? w : h;
+
+    bool has_axis = false;
+    std::int64_t axis2 = 0; // 對稱軸位置的兩倍
+    auto MatchAxis = [&](std::int64_t pos2) {
+        if (!has_axis) {
+            axis2 = pos2;
+            has_axis = true;
+        }
+        return pos2 == axis2;
+    };
+
+    for (const auto &pair: group.pairs) {
+        const int a = pair.aid;
+        const int b = pair.bid;
+        // 輸入保證兩個 block 旋轉後可以同樣大小，寬高不同表示方向不同
+        if (w[a] != w[b] || h[a] != h[b]) {
+            message = "Symmetry Constraint Violated! The hard blocks \"" + table.names[a] +
+                          "\" and \"" + table.names[b] + "\" in the same symmetry pair should "
+                          "have the same orientation.";
+            return false;
+        }
+        if (across[a] != across[b]) {
+            message = "Symmetry Constraint Violated! The hard blocks \"" + table.names[a] +
+                          "\" and \"" + table.names[b] + "\" in the same symmetry pair should be "
+                          "symmetric in either horizontal or vertical symmetry axis.";
+            return false;
+        }
+        // 兩個中心的和就是軸的兩倍
+        if (!MatchAxis((std::int64_t)along[a] + along[b] + size[a])) {
+            message = "Symmetry Constraint Violated! The symmetry pair in the symmetry group \"" +
+                          group.name + "\" should be symmetric in the same axis.";
+            return false;
+        }
+    }
+    for (const auto &self: group.selfs) {
+        const int s = self.id;
+        if (!MatchAxis(2 * (std::int64_t)along[s] + size[s])) {
+            message = "Symmetry Constraint Violated! The hard block \"" + table.names[s] +
+                          "\" in the symmetry group \"" + group.name +
+                          "\" should be symmetric in the same axis.";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+VerifyResult VerifyPlacement(const BlockTable &table,
+                             const std::vector<SymmGroup> &groups,
+                             const Placement &placement,
+                             std::int64_t reported_area) {
+    VerifyResult result;
+    const int n = placement.Size();
+
+    // 旋轉後的寬高攤平成陣列，之後的 kernel 都不必再看旋轉
+    std::vector<std::int32_t> w(n), h(n);
+    for (int i = 0; i < n; ++i) {
+        w[i] = placement.GetRotatedWidth(i);
+        h[i] = placement.GetRotatedHeight(i);
+    }
+    const auto &x = placement.x;
+    const auto &y = placement.y;
+
+    /* 座標 */
+    for (int i = 0; i < n; ++i) {
+        if (x[i] < 0 || y[i] < 0) {
+            AddError(result, "Wrong Coordinate! The coordinate of hard block \"" +
+                                 table.names[i] + "\" should be non-negative.");
+        }
+    }
+
+    /* 重疊：sweep line 只回報找到的第一對 */
+    const auto overlap = FindOverlap(x.data(), y.data(), w.data(), h.data(), n);
+    if (overlap.first >= 0) {
+        const int a = std::min(overlap.first, overlap.second);
+        const int b = std::max(overlap.first, overlap.second);
+        AddError(result, "Non-overlapping Constraint Violated! Hard block \"" + table.names[a] +
+                             "\" overlaps with hard block \"" + table.names[b] + "\".");
+    }
+
+    /* 對稱：輸出檔沒有記錄對稱軸的方向，兩種都試，都不符合時回報垂直軸的原因 */
+    for (const auto &group: groups) {
+        std::string vertical_message, horizontal_message;
+        if (!CheckGroupAxis(group, Axis::kVertical, x, y, w, h, table, vertical_message) &&
+                !CheckGroupAxis(group, Axis::kHorizontal, x, y, w, h, table, horizontal_message)) {
+            AddError(result, vertical_message);
+        }
+    }
+
+    /* 面積 */
+    const BoundingBox box = ComputeBoundingBox(x.data(), y.data(), w.data(), h.data(), n);
+    result.width = std::max(0, box.max_x);
+    result.height = std::max(0, box.max_y);
+    result.area = result.width * result.height;
+    if (result.area != reported_area) {
+        AddError(result, "Wrong Area! \"Area " + std::to_string(reported_area) +
+                             "\" should be \"Area " + std::to_string(result.area) + "\".");
+    }
+    return result;
+}
+
+void PrintErrors(std::ostream &out, const VerifyResult &result) {
+    for (const auto &error: result.errors) {
+        out << error << "\n";
+    }
+    if (result.num_errors > (int)result.errors.size()) {
+        out << "[Error] ... and " << result.num_errors - (int)result.errors.size()
+                << " more errors\n";
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+/*
+ * 在程式內檢查擺放是否合法，規則、檢查順序與錯誤訊息都與 verifier/verify 相同：
+ *   - 座標不能是負的
+ *   - block 之間不能重疊，只有邊相接不算
+ *   - 每個對稱群有一條共同的垂直或水平對稱軸，SymPair 兩個 block 旋轉後
+ *     方向相同且對稱於軸，SymSelf 的中心在軸上
+ *   - 面積是所有 block 右上角的最大 x 乘上最大 y，必須與輸出的 Area 相同
+ * verifier/verify 只回報第一個錯誤，這裡會繼續檢查，第一條錯誤與它相同。
+ * 重疊以 sweep line 檢查，十萬個 block 只需要幾十毫秒。
+ */
+struct VerifyResult {
+    bool legal{true};
+    std::int64_t area{0};              // 由座標算出的面積
+    std::int64_t width{0}, height{0};
+    std::vector<std::string> errors;   // 依照檢查順序，最多 kMaxErrors 條，格式與 verifier/verify 相同
+    int num_errors{0};                 // 所有錯誤的數量
+
+    static constexpr int kMaxErrors = 20;
+};
+
+// reported_area 是輸出檔中的 Area
+VerifyResult VerifyPlacement(const BlockTable &table,
+                             const std::vector<SymmGroup> &groups,
+                             const Placement &placement,
+                             std::int64_t reported_area);
+
+// 逐行印出錯誤，超過 kMaxErrors 條時最後註明還有幾條
+void PrintErrors(std::ostream &out, const VerifyResult &result);
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <numeric>
+
+#include "wirelength.hpp"
+
+std::int64_t WirelengthEvaluator::Compute(const Placement& placement) {
+    const int bsize = placement.Size();
+    if ((int)x_order_.size() != bsize) {
+        x_order_.resize(bsize);
+        y_order_.resize(bsize);
+        std::iota(std::begin(x_order_), std::end(x_order_), 0);
+        std::iota(std::begin(y_order_), std::end(y_order_), 0);
+        x_centers_.resize(bsize);
+        y_centers_.resize(bsize);
+    }
+
+    // 與原本一樣先做整數除法取中心，結果是整數，不會有捨入誤差
+    for (int i = 0; i < bsize; ++i) {
+        x_centers_[i] = placement.x[i] + placement.GetRotatedWidth(i) / 2;
+        y_centers_[i] = placement.y[i] + placement.GetRotatedHeight(i) / 2;
+    }
+    return SumAxis(x_order_, x_centers_) + SumAxis(y_order_, y_centers_);
+}
+
+std::int64_t WirelengthEvaluator::SumAxis(std::vector<int>& order,
+                                          const std::vector<std::int64_t>& centers) {
+    const int size = order.size();
+    auto Less = [&](int a, int b) { return centers[a] < centers[b]; };
+
+    // 從上一次的順序開始做 insertion sort，搬移太多次就改用 std::sort
+    std::int64_t budget = 8 * (std::int64_t)size;
+    for (int i = 1; i < size && budget >= 0; ++i) {
+        int id = order[i];
+        int j = i;
+        while (j > 0 && Less(id, order[j-1])) {
+            order[j] = order[j-1];
+            --j;
+        }
+        order[j] = id;
+        budget -= i - j;
+    }
+    if (budget < 0) {
+        std::sort(std::begin(order), std::end(order), Less);
+    }
+
+    std::int64_t sum = 0;
+    for (int i = 0; i < size; ++i) {
+        sum += centers[order[i]] * (2 * i - size + 1);
+    }
+    return sum;
+}
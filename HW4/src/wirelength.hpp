@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+/*
+ * 計算所有 block 中心兩兩之間的 Manhattan 距離總和。
+ * x 與 y 兩個方向彼此獨立，各自排序後第 i 小的中心會被加 i 次、
+ * 減 (n-1-i) 次，所以只需要 O(N log N)。
+ * 排序順序會保留到下一次計算，只有少數 block 移動時接近 O(N)。
+ */
+class WirelengthEvaluator {
+public:
+    std::int64_t Compute(const Placement& placement);
+
+private:
+    static std::int64_t SumAxis(std::vector<int>& order,
+                                const std::vector<std::int64_t>& centers);
+
+    std::vector<int> x_order_, y_order_;          // 上一次的排序結果
+    std::vector<std::int64_t> x_centers_, y_centers_; // 以 block id 為索引
+};